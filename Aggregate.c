@@ -0,0 +1,355 @@
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+
+// Aggregates over the primes of a range, computed right after each segment is sieved. The primes are never
+// written out, so a range of any width needs one segment of memory and a single pass. Pairs and tuplets that
+// cross a segment boundary are found through the last primes of the previous segment, which are kept in the state.
+//
+// Aggregates of neighbouring ranges can be merged, e.g. the results of shards that ran in other processes.
+//
+// Runs near the 64 bit limit take weeks, so the state can be written into a checkpoint file between two segments.
+// The state at a segment end is complete (cursor and the aggregates with their last primes), a resumed run therefore
+// continues with exactly the same numbers and ends with the same result.
+
+// "PGCHKPT1" in ASCII
+#define CHECKPOINT_MAGIC    0x3154504b48434750ULL
+// layout version of the file, incremented whenever checkpoint_record_t or primegen_aggregate changes
+#define CHECKPOINT_VERSION  2
+#define CHECKPOINT_INTERVAL 60
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t done;              // the query is complete, agg is the final result
+    uint64_t low;               // the query, a checkpoint is only resumed by the same query
+    uint64_t high;
+    uint64_t limit;
+    uint64_t cursor;            // first number that is not aggregated yet
+    primegen_aggregate agg;
+    uint64_t check;             // hash of all fields above, detects a torn or foreign file
+} checkpoint_record_t;
+
+typedef struct {
+    primegen_aggregate* agg;
+    uint64_t limit;             // the aggregation stops after limit primes
+    uint64_t low;               // the query, stored in the checkpoints
+    uint64_t high;
+    const primegen_checkpoint* checkpoint;  // NULL if no checkpoints are written
+    struct timespec written;    // time of the last checkpoint
+    int status;                 // PRIMEGEN_EIO once a checkpoint could not be written
+} aggregate_state_t;
+
+// finalizer of splitmix64, spreads the bits of a prime so that the xor of many primes is a useful hash
+uint64_t mixPrime(uint64_t p){
+    p = (p ^ (p >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    p = (p ^ (p >> 27)) * 0x94d049bb133111ebULL;
+    return p ^ (p >> 31);
+}
+
+static uint64_t recordCheck(const checkpoint_record_t* record){
+
+    const uint64_t* words = (const uint64_t*)record;
+    uint64_t check = CHECKPOINT_MAGIC;
+    for(size_t i = 0 ; i < offsetof(checkpoint_record_t, check) / sizeof(uint64_t) ; i++){
+        check = mixPrime(check ^ words[i]);
+    }
+    return check;
+}
+
+// writes the state into a temporary file that replaces the checkpoint afterwards, so a crash while writing leaves
+// the previous checkpoint intact
+static bool writeCheckpoint(const aggregate_state_t* state, uint64_t cursor, bool done){
+
+    checkpoint_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.magic = CHECKPOINT_MAGIC;
+    record.version = CHECKPOINT_VERSION;
+    record.done = done;
+    record.low = state->low;
+    record.high = state->high;
+    record.limit = state->limit;
+    record.cursor = cursor;
+    record.agg = *state->agg;
+    record.check = recordCheck(&record);
+
+    const char* path = state->checkpoint->path;
+    size_t len = strlen(path);
+    char* temp = (char*)malloc(len + 5);
+    if(temp == NULL){
+        return false;
+    }
+    memcpy(temp, path, len);
+    memcpy(temp + len, ".tmp", 5);
+
+    bool written = false;
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd >= 0){
+        written = write(fd, &record, sizeof(record)) == (ssize_t)sizeof(record) && fsync(fd) == 0;
+        close(fd);
+        written = written && rename(temp, path) == 0;
+        if(!written){
+            unlink(temp);
+        }
+    }
+    free(temp);
+    return written;
+}
+
+// restores the state of a checkpoint of the same query. Returns PRIMEGEN_OK with *cursor set if the file holds one,
+// PRIMEGEN_ERANGE if there is no file and PRIMEGEN_EIO if the file can not be read or belongs to another query.
+static int readCheckpoint(aggregate_state_t* state, uint64_t* cursor, bool* done){
+
+    int fd = open(state->checkpoint->path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return (errno == ENOENT) ? PRIMEGEN_ERANGE : PRIMEGEN_EIO;
+    }
+    checkpoint_record_t record;
+    ssize_t size = read(fd, &record, sizeof(record));
+    close(fd);
+
+    if(size != (ssize_t)sizeof(record) || record.magic != CHECKPOINT_MAGIC || record.version != CHECKPOINT_VERSION
+        || record.check != recordCheck(&record) || record.low != state->low || record.high != state->high
+        || record.limit != state->limit){
+        return PRIMEGEN_EIO;
+    }
+    *state->agg = record.agg;
+    *cursor = record.cursor;
+    *done = record.done;
+    return PRIMEGEN_OK;
+}
+
+// true if p - d is one of the last primes
+static bool recentPrime(const primegen_aggregate* agg, uint64_t p, uint64_t d){
+
+    // at most 4 primes can lie in [p - 8, p - 1], so the tail always holds every candidate
+    for(int i = 0 ; i < 4 && agg->tail[i] != 0 ; i++){
+        if(agg->tail[i] == p - d){
+            return true;
+        }
+        if(agg->tail[i] < p - d){
+            return false;
+        }
+    }
+    return false;
+}
+
+static void aggregateAdd(primegen_aggregate* agg, uint64_t p){
+
+    if(agg->count < 4){
+        agg->head[agg->count] = p;
+    }
+    if(agg->count == 0){
+        agg->first = p;
+    }else if(p - agg->last > agg->maxGap){
+        agg->maxGap = p - agg->last;
+        agg->maxGapStart = agg->last;
+    }
+
+    bool two = recentPrime(agg, p, 2);
+    bool four = recentPrime(agg, p, 4);
+    bool six = recentPrime(agg, p, 6);
+    agg->twins += two;
+    agg->cousins += four;
+    agg->sexy += six;
+    // every constellation is counted at its largest prime, so all of its members lie in the range
+    agg->triplets += (six && two) + (six && four);
+    agg->quadruplets += (six && two && recentPrime(agg, p, 8));
+
+    agg->count++;
+    agg->sum += p;
+    agg->checksum ^= mixPrime(p);
+    agg->last = p;
+    memmove(&agg->tail[1], &agg->tail[0], 3 * sizeof(uint64_t));
+    agg->tail[0] = p;
+}
+
+static bool aggregateSegment(const primegen_segment* seg, void* arg){
+
+    aggregate_state_t* state = (aggregate_state_t*)arg;
+    uint64_t width = seg->high - seg->low;
+    uint64_t i = 0;
+    while(i <= width){
+        // most numbers are composite, so 8 of them are skipped at once if none is prime
+        if(width - i >= 7){
+            uint64_t word;
+            memcpy(&word, &seg->arr[i], sizeof(word));
+            if(word == 0){
+                i += 8;
+                continue;
+            }
+        }
+        if(seg->arr[i]){
+            aggregateAdd(state->agg, seg->low + i);
+            if(state->agg->count == state->limit){
+                return false;
+            }
+        }
+        i++;
+    }
+
+    // reading the clock costs nanoseconds against milliseconds for sieving a segment, the last segment is
+    // written by the caller as the final checkpoint
+    if(state->checkpoint != NULL && seg->high != state->high){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if(now.tv_sec - state->written.tv_sec >= (time_t)state->checkpoint->interval){
+            if(!writeCheckpoint(state, seg->high + 1, false)){
+                state->status = PRIMEGEN_EIO;
+                return false;
+            }
+            state->written = now;
+        }
+    }
+    return true;
+}
+
+static int aggregate(const primegen_ctx* ctx, uint64_t low, uint64_t high, uint64_t limit,
+    const primegen_checkpoint* checkpoint, primegen_aggregate* agg){
+
+    memset(agg, 0, sizeof(primegen_aggregate));
+    aggregate_state_t state = {agg, limit, low, high, NULL, {0, 0}, PRIMEGEN_OK};
+    primegen_checkpoint settings;
+    uint64_t cursor = low;
+    bool done = false;
+
+    if(checkpoint != NULL){
+        settings = *checkpoint;
+        if(settings.interval == 0){
+            settings.interval = CHECKPOINT_INTERVAL;
+        }
+        state.checkpoint = &settings;
+        if(readCheckpoint(&state, &cursor, &done) == PRIMEGEN_EIO){
+            return PRIMEGEN_EIO;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &state.written);
+    }
+
+    // a finished checkpoint already holds the result
+    if(!done){
+        int status = sieveRange(ctx, cursor, high, aggregateSegment, &state);
+        if(status == PRIMEGEN_OK){
+            status = state.status;
+        }
+        if(status == PRIMEGEN_OK && state.checkpoint != NULL && !writeCheckpoint(&state, high, true)){
+            status = PRIMEGEN_EIO;
+        }
+        if(status != PRIMEGEN_OK){
+            return status;
+        }
+    }
+    return (limit != UINT64_MAX && agg->count < limit) ? PRIMEGEN_ERANGE : PRIMEGEN_OK;
+}
+
+int primegen_aggregate_range(const primegen_ctx* ctx, uint64_t low, uint64_t high, const primegen_checkpoint* checkpoint,
+    primegen_aggregate* agg){
+
+    if(ctx == NULL || agg == NULL || low > high || (checkpoint != NULL && checkpoint->path == NULL)){
+        return PRIMEGEN_EINVAL;
+    }
+    return aggregate(ctx, low, high, UINT64_MAX, checkpoint, agg);
+}
+
+int primegen_aggregate_first(const primegen_ctx* ctx, uint64_t n, const primegen_checkpoint* checkpoint,
+    primegen_aggregate* agg){
+
+    if(ctx == NULL || agg == NULL || n == 0 || (checkpoint != NULL && checkpoint->path == NULL)){
+        return PRIMEGEN_EINVAL;
+    }
+    // the bound of approximate() ends the range, as for primegen_nth_prime()
+    uint64_t high = (n >= SIZE_MAX) ? UINT64_MAX : approximate((size_t)n);
+    return aggregate(ctx, 0, high, n, checkpoint, agg);
+}
+
+// offsets of the constellations, the first entry is the number of primes
+static const uint64_t constellations[][5] = {
+    {2, 0, 2},          // twins
+    {2, 0, 4},          // cousins
+    {2, 0, 6},          // sexy
+    {3, 0, 2, 6},       // triplets
+    {3, 0, 4, 6},
+    {4, 0, 2, 6, 8}     // quadruplets
+};
+
+static bool containsPrime(const uint64_t* primes, size_t count, uint64_t p){
+
+    for(size_t i = 0 ; i < count ; i++){
+        if(primes[i] == p){
+            return true;
+        }
+    }
+    return false;
+}
+
+int primegen_aggregate_merge(primegen_aggregate* agg, const primegen_aggregate* next){
+
+    if(agg == NULL || next == NULL || (agg->count != 0 && next->count != 0 && next->first <= agg->last)){
+        return PRIMEGEN_EINVAL;
+    }
+    if(next->count == 0){
+        return PRIMEGEN_OK;
+    }
+    if(agg->count == 0){
+        *agg = *next;
+        return PRIMEGEN_OK;
+    }
+
+    // a constellation spans at most 8, so all constellations across the border lie in the tail of agg and the head
+    // of next. Those that start in agg and end in next are counted here, the others are counted already.
+    uint64_t border[8];
+    size_t count = 0;
+    for(int i = 0 ; i < 4 ; i++){
+        if(agg->tail[i] != 0){
+            border[count++] = agg->tail[i];
+        }
+        if(next->head[i] != 0){
+            border[count++] = next->head[i];
+        }
+    }
+    uint64_t* counters[] = {&agg->twins, &agg->cousins, &agg->sexy, &agg->triplets, &agg->triplets, &agg->quadruplets};
+    for(int i = 0 ; i < 4 && agg->tail[i] != 0 ; i++){
+        uint64_t q = agg->tail[i];
+        for(size_t c = 0 ; c < sizeof(constellations) / sizeof(constellations[0]) ; c++){
+            uint64_t size = constellations[c][0];
+            if(q + constellations[c][size] <= agg->last || q + constellations[c][size] < q){
+                continue;
+            }
+            bool complete = true;
+            for(uint64_t k = 1 ; k <= size && complete ; k++){
+                complete = containsPrime(border, count, q + constellations[c][k]);
+            }
+            *counters[c] += complete;
+        }
+    }
+
+    uint64_t gap = next->first - agg->last;
+    if(gap > agg->maxGap){
+        agg->maxGap = gap;
+        agg->maxGapStart = agg->last;
+    }
+    if(next->maxGap > agg->maxGap){
+        agg->maxGap = next->maxGap;
+        agg->maxGapStart = next->maxGapStart;
+    }
+
+    // the head keeps the primes of agg first, the tail the primes of next
+    for(uint64_t i = agg->count, j = 0 ; i < 4 ; i++, j++){
+        agg->head[i] = next->head[j];
+    }
+    uint64_t tail[4];
+    for(uint64_t i = 0 ; i < 4 ; i++){
+        tail[i] = (i < next->count) ? next->tail[i] : agg->tail[i - next->count];
+    }
+    memcpy(agg->tail, tail, sizeof(tail));
+
+    agg->count += next->count;
+    agg->sum += next->sum;
+    agg->checksum ^= next->checksum;
+    agg->twins += next->twins;
+    agg->cousins += next->cousins;
+    agg->sexy += next->sexy;
+    agg->triplets += next->triplets;
+    agg->quadruplets += next->quadruplets;
+    agg->last = next->last;
+    return PRIMEGEN_OK;
+}
@@ -0,0 +1,333 @@
+#include "config.h"
+
+// Batches of pi(x) and nth prime queries. Answered one by one, every query sieves the prefix before it again. A
+// batch is sorted and answered by a single sweep from the end of the table to its largest query instead. Threads
+// take the segments of the sweep one by one and count their primes, for pi also the primes of a segment until each
+// query in it, so the running count is recorded as the sweep crosses a query. A prefix sum over the segment counts
+// then gives every answer. The segment of an nth prime is only known after the prefix sum, so the segments that
+// hold an answer are sieved once more.
+
+#define MAX_BATCH_THREADS   64
+
+typedef struct {
+    uint64_t key;       // x of pi or n of the nth prime
+    size_t index;       // position of the query in the list of the caller
+} batch_query_t;
+
+typedef struct {
+    const uint32_t* primes;         // sieving primes until sqrt(high)
+    size_t primeCount;
+    uint64_t low;                   // the sweep covers [low, high]
+    uint64_t high;
+    size_t segmentSize;
+    size_t segments;
+    uint64_t* counts;               // primes per segment, primes before the segment after the prefix sum
+    const batch_query_t* queries;   // sorted queries of the sweep
+    size_t queryCount;
+    uint64_t* results;              // pi: primes of the segment until the query, nth: the prime
+    size_t* groups;                 // nth: first query of every segment that holds answers, queryCount at the end
+    size_t* segmentOf;              // nth: segment of every query
+    size_t items;                   // segments or groups the workers take
+    size_t next;                    // next item, taken by an atomic increment
+    bool failed;                    // memory of a worker can not be allocated
+} batch_sweep_t;
+
+static int compareQueries(const void* a, const void* b){
+    uint64_t x = ((const batch_query_t*)a)->key;
+    uint64_t y = ((const batch_query_t*)b)->key;
+    return (x > y) - (x < y);
+}
+
+// the segments are aligned to the segment size like the segments of sieveRange(), the first and the last one are clipped
+static void segmentBounds(const batch_sweep_t* s, size_t k, uint64_t* low, uint64_t* high){
+
+    uint64_t segLow = (s->low / s->segmentSize + k) * s->segmentSize;
+    uint64_t segHigh = segLow + (s->segmentSize - 1);
+    *low = (segLow < s->low) ? s->low : segLow;
+    *high = (segHigh > s->high) ? s->high : segHigh;
+}
+
+static size_t segmentIndex(const batch_sweep_t* s, uint64_t x){
+    return (size_t)(x / s->segmentSize - s->low / s->segmentSize);
+}
+
+// index of the first sorted query that is >= key
+static size_t lowerBound(const batch_query_t* queries, size_t count, uint64_t key){
+
+    size_t lo = 0;
+    size_t hi = count;
+    while(lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        if(queries[mid].key < key){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void* countWorker(void* arg){
+
+    batch_sweep_t* s = (batch_sweep_t*)arg;
+    bool* arr = (bool*)malloc(s->segmentSize);
+    if(arr == NULL){
+        __atomic_store_n(&s->failed, true, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    size_t k;
+    while((k = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED)) < s->items){
+        uint64_t low, high;
+        segmentBounds(s, k, &low, &high);
+        sieveSegment(low, high, arr, s->primes, s->primeCount);
+
+        // the queries of the segment are sorted, the count is recorded as the walk crosses each of them
+        uint64_t count = 0;
+        uint64_t i = 0;
+        for(size_t q = lowerBound(s->queries, s->queryCount, low) ; q < s->queryCount && s->queries[q].key <= high ; q++){
+            for( ; i <= s->queries[q].key - low ; i++){
+                count += arr[i];
+            }
+            s->results[q] = count;
+        }
+        for( ; i <= high - low ; i++){
+            count += arr[i];
+        }
+        s->counts[k] = count;
+    }
+    free(arr);
+    return NULL;
+}
+
+static void* locateWorker(void* arg){
+
+    batch_sweep_t* s = (batch_sweep_t*)arg;
+    bool* arr = (bool*)malloc(s->segmentSize);
+    if(arr == NULL){
+        __atomic_store_n(&s->failed, true, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    size_t g;
+    while((g = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED)) < s->items){
+        size_t q = s->groups[g];
+        size_t k = s->segmentOf[q];
+        uint64_t low, high;
+        segmentBounds(s, k, &low, &high);
+        sieveSegment(low, high, arr, s->primes, s->primeCount);
+
+        // keys are the ranks after the table, the segment starts with counts[k] primes before it
+        uint64_t count = s->counts[k];
+        for(uint64_t i = 0 ; i <= high - low && q < s->groups[g + 1] ; i++){
+            count += arr[i];
+            for( ; q < s->groups[g + 1] && s->queries[q].key == count && arr[i] ; q++){
+                s->results[q] = low + i;
+            }
+        }
+    }
+    free(arr);
+    return NULL;
+}
+
+// runs worker in threads threads, the calling thread included, until all items are taken
+static bool runBatch(void* (*worker)(void*), batch_sweep_t* s, int threads){
+
+    pthread_t tids[MAX_BATCH_THREADS];
+    int started = 0;
+    s->next = 0;
+    while(started + 1 < threads && started + 1 < MAX_BATCH_THREADS && (size_t)started + 1 < s->items
+          && pthread_create(&tids[started], NULL, worker, s) == 0){
+        started++;
+    }
+    worker(s);
+    for(int i = 0 ; i < started ; i++){
+        pthread_join(tids[i], NULL);
+    }
+    return !s->failed;
+}
+
+// sets up the sweep over [low, high] with its sieving primes, the caller frees counts and own
+static int prepareSweep(const primegen_ctx* ctx, batch_sweep_t* s, uint64_t low, uint64_t high, uint32_t** own){
+
+    s->low = low;
+    s->high = high;
+    s->segmentSize = ctx->tuning.segmentSize;
+    s->segments = (size_t)(high / s->segmentSize - low / s->segmentSize) + 1;
+    s->primes = ctx->sievingPrimes;
+    s->primeCount = ctx->sievingCount;
+    *own = NULL;
+    if(high > ctx->tuning.sieveLimit){
+        s->primeCount = sievingPrimes(isqrt(high), own);
+        if(s->primeCount == SIZE_MAX){
+            return PRIMEGEN_ENOMEM;
+        }
+        s->primes = *own;
+    }
+    s->counts = (uint64_t*)malloc(s->segments * sizeof(uint64_t));
+    return (s->counts == NULL) ? PRIMEGEN_ENOMEM : PRIMEGEN_OK;
+}
+
+// turns the segment counts into the number of primes before every segment, the total is returned
+static uint64_t prefixSum(batch_sweep_t* s){
+
+    uint64_t total = 0;
+    for(size_t k = 0 ; k < s->segments ; k++){
+        uint64_t count = s->counts[k];
+        s->counts[k] = total;
+        total += count;
+    }
+    return total;
+}
+
+int primegen_pi_batch(const primegen_ctx* ctx, const uint64_t x[], size_t count, uint64_t counts[]){
+
+    if(ctx == NULL || (count != 0 && (x == NULL || counts == NULL))){
+        return PRIMEGEN_EINVAL;
+    }
+
+    // queries inside the table are answered from it, the others are swept after its last prime
+    const uint64_t* table;
+    size_t tableSize = readyTable(ctx, &table);
+    batch_query_t* queries = (batch_query_t*)malloc((count + 1) * sizeof(batch_query_t));
+    if(queries == NULL){
+        return PRIMEGEN_ENOMEM;
+    }
+    size_t swept = 0;
+    for(size_t i = 0 ; i < count ; i++){
+        if(tableSize != 0 && x[i] <= table[tableSize - 1]){
+            size_t lo = 0;
+            size_t hi = tableSize;
+            while(lo < hi){
+                size_t mid = lo + (hi - lo) / 2;
+                if(table[mid] <= x[i]){
+                    lo = mid + 1;
+                }else{
+                    hi = mid;
+                }
+            }
+            counts[i] = lo;
+        }else{
+            queries[swept].key = x[i];
+            queries[swept++].index = i;
+        }
+    }
+    if(swept == 0){
+        free(queries);
+        return PRIMEGEN_OK;
+    }
+    qsort(queries, swept, sizeof(batch_query_t), compareQueries);
+
+    batch_sweep_t s;
+    memset(&s, 0, sizeof(s));
+    uint32_t* own;
+    uint64_t low = (tableSize != 0) ? table[tableSize - 1] + 1 : 0;
+    int status = prepareSweep(ctx, &s, low, queries[swept - 1].key, &own);
+    s.queries = queries;
+    s.queryCount = swept;
+    s.results = (uint64_t*)malloc(swept * sizeof(uint64_t));
+    s.items = s.segments;
+    if(status == PRIMEGEN_OK && (s.results == NULL || !runBatch(countWorker, &s, ctx->tuning.threads))){
+        status = PRIMEGEN_ENOMEM;
+    }
+    if(status == PRIMEGEN_OK){
+        prefixSum(&s);
+        for(size_t q = 0 ; q < swept ; q++){
+            counts[queries[q].index] = tableSize + s.counts[segmentIndex(&s, queries[q].key)] + s.results[q];
+        }
+    }
+    free(s.results);
+    free(s.counts);
+    free(own);
+    free(queries);
+    return status;
+}
+
+int primegen_nth_prime_batch(const primegen_ctx* ctx, const uint64_t n[], size_t count, uint64_t primes[]){
+
+    if(ctx == NULL || (count != 0 && (n == NULL || primes == NULL))){
+        return PRIMEGEN_EINVAL;
+    }
+
+    // queries inside the table are answered from it, the others become ranks after its last prime
+    const uint64_t* table;
+    size_t tableSize = readyTable(ctx, &table);
+    batch_query_t* queries = (batch_query_t*)malloc((count + 1) * sizeof(batch_query_t));
+    if(queries == NULL){
+        return PRIMEGEN_ENOMEM;
+    }
+    size_t swept = 0;
+    for(size_t i = 0 ; i < count ; i++){
+        if(n[i] == 0){
+            free(queries);
+            return PRIMEGEN_EINVAL;
+        }
+        if(n[i] <= tableSize){
+            primes[i] = table[n[i] - 1];
+        }else{
+            queries[swept].key = n[i] - tableSize;
+            queries[swept++].index = i;
+        }
+    }
+    if(swept == 0){
+        free(queries);
+        return PRIMEGEN_OK;
+    }
+    qsort(queries, swept, sizeof(batch_query_t), compareQueries);
+
+    // the bound of approximate() for the largest n ends the sweep, as in primegen_nth_prime()
+    uint64_t largest = queries[swept - 1].key + tableSize;
+    uint64_t low = (tableSize != 0) ? table[tableSize - 1] + 1 : 0;
+    uint64_t high = (largest >= SIZE_MAX) ? UINT64_MAX : approximate((size_t)largest);
+    high = (high < low) ? UINT64_MAX : high;
+
+    batch_sweep_t s;
+    memset(&s, 0, sizeof(s));
+    uint32_t* own;
+    int status = prepareSweep(ctx, &s, low, high, &own);
+    s.items = s.segments;
+    if(status == PRIMEGEN_OK && !runBatch(countWorker, &s, ctx->tuning.threads)){
+        status = PRIMEGEN_ENOMEM;
+    }
+    uint64_t total = (status == PRIMEGEN_OK) ? prefixSum(&s) : 0;
+    if(status == PRIMEGEN_OK && queries[swept - 1].key > total){
+        status = PRIMEGEN_ERANGE;
+    }
+
+    // every query lies in the last segment with fewer primes before it than its rank, the queries of one segment form a group
+    s.queries = queries;
+    s.queryCount = swept;
+    s.results = (uint64_t*)malloc(swept * sizeof(uint64_t));
+    s.segmentOf = (size_t*)malloc(swept * sizeof(size_t));
+    s.groups = (size_t*)malloc((swept + 1) * sizeof(size_t));
+    if(status == PRIMEGEN_OK && (s.results == NULL || s.segmentOf == NULL || s.groups == NULL)){
+        status = PRIMEGEN_ENOMEM;
+    }
+    if(status == PRIMEGEN_OK){
+        size_t k = 0;
+        s.items = 0;
+        for(size_t q = 0 ; q < swept ; q++){
+            while(k + 1 < s.segments && s.counts[k + 1] < queries[q].key){
+                k++;
+            }
+            s.segmentOf[q] = k;
+            if(q == 0 || s.segmentOf[q - 1] != k){
+                s.groups[s.items++] = q;
+            }
+        }
+        s.groups[s.items] = swept;
+        if(!runBatch(locateWorker, &s, ctx->tuning.threads)){
+            status = PRIMEGEN_ENOMEM;
+        }
+    }
+    if(status == PRIMEGEN_OK){
+        for(size_t q = 0 ; q < swept ; q++){
+            primes[queries[q].index] = s.results[q];
+        }
+    }
+    free(s.results);
+    free(s.segmentOf);
+    free(s.groups);
+    free(s.counts);
+    free(own);
+    free(queries);
+    return status;
+}
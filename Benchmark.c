@@ -15,3 +15,20 @@ double get_time_prim(size_t (*f) (size_t,uint64_t*),size_t size, uint64_t* prims
     return time;
     
 }
+
+// same as get_time_prim() for the LUT versions, which copy from the given table
+double get_time_table(size_t (*f) (const uint64_t*,size_t,uint64_t*),const uint64_t* table,size_t size, uint64_t* prims, int repeat){
+
+    size_t res;
+    double time = 0; 
+    struct timespec start;      
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0 ; i < repeat ; i++){
+        res = f(table,size,prims);
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    time += end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    return time;
+    
+}
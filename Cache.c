@@ -0,0 +1,213 @@
+#include "config.h"
+
+// LRU cache of sieved segments. Repeated queries often hit the same windows, so the result of sieving a segment is
+// kept as a compact bitmap keyed by its segment index. Only odd numbers are stored (bit j <=> segLow + 2j + 1), which
+// takes segmentSize / 16 bytes per segment. Entries are pinned by a reference count while a caller decodes them,
+// so the lock is only held for the lookup itself and never while a segment is sieved or decoded.
+
+typedef struct cache_entry {
+    uint64_t index;                 // segment index, the segment covers [index * segmentSize, (index + 1) * segmentSize - 1]
+    struct cache_entry* hashNext;   // next entry in the same hash bucket
+    struct cache_entry* newer;      // LRU list, the most recently used entry is the head
+    struct cache_entry* older;
+    int refs;                       // callers that are decoding the entry, pinned entries are not evicted
+    uint64_t bits[];
+} cache_entry_t;
+
+struct primegen_cache {
+    pthread_mutex_t lock;
+    size_t segmentSize;
+    size_t entryBytes;              // memory of one entry, bitmap included
+    size_t capacity;                // memory cap in bytes
+    size_t used;
+    cache_entry_t** buckets;
+    size_t bucketMask;
+    cache_entry_t* newest;
+    cache_entry_t* oldest;
+    primegen_cache_stats stats;
+};
+
+// fibonacci hashing, consecutive segment indexes are spread over all buckets
+static size_t bucketOf(const primegen_cache* cache, uint64_t index){
+    return (size_t)((index * 0x9e3779b97f4a7c15ULL) >> 17) & cache->bucketMask;
+}
+
+primegen_cache* createCache(size_t capacity, size_t segmentSize){
+
+    primegen_cache* cache = (primegen_cache*)calloc(1, sizeof(primegen_cache));
+    if(cache == NULL){
+        return NULL;
+    }
+    cache->segmentSize = segmentSize;
+    cache->entryBytes = sizeof(cache_entry_t) + segmentSize / 16;
+    cache->capacity = capacity;
+
+    // about two buckets per entry that fits into the cap
+    size_t buckets = 16;
+    while(buckets < 2 * (capacity / cache->entryBytes)){
+        buckets *= 2;
+    }
+    cache->buckets = (cache_entry_t**)calloc(buckets, sizeof(cache_entry_t*));
+    if(cache->buckets == NULL){
+        free(cache);
+        return NULL;
+    }
+    cache->bucketMask = buckets - 1;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void destroyCache(primegen_cache* cache){
+
+    if(cache == NULL){
+        return;
+    }
+    cache_entry_t* entry = cache->newest;
+    while(entry != NULL){
+        cache_entry_t* older = entry->older;
+        free(entry);
+        entry = older;
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+static void unlinkLRU(primegen_cache* cache, cache_entry_t* entry){
+
+    if(entry->newer != NULL){
+        entry->newer->older = entry->older;
+    }else{
+        cache->newest = entry->older;
+    }
+    if(entry->older != NULL){
+        entry->older->newer = entry->newer;
+    }else{
+        cache->oldest = entry->newer;
+    }
+}
+
+static void pushNewest(primegen_cache* cache, cache_entry_t* entry){
+
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if(cache->newest != NULL){
+        cache->newest->newer = entry;
+    }
+    cache->newest = entry;
+    if(cache->oldest == NULL){
+        cache->oldest = entry;
+    }
+}
+
+// evicts the least recently used entries that are not pinned until the cache fits into its cap
+static void evict(primegen_cache* cache){
+
+    cache_entry_t* entry = cache->oldest;
+    while(cache->used > cache->capacity && entry != NULL){
+        cache_entry_t* newer = entry->newer;
+        if(entry->refs == 0){
+            cache_entry_t** link = &cache->buckets[bucketOf(cache, entry->index)];
+            while(*link != entry){
+                link = &(*link)->hashNext;
+            }
+            *link = entry->hashNext;
+            unlinkLRU(cache, entry);
+            cache->used -= cache->entryBytes;
+            cache->stats.evictions++;
+            free(entry);
+        }
+        entry = newer;
+    }
+}
+
+// looks up a segment, the returned entry is pinned until releaseSegment() is called. NULL is returned on a miss.
+const cache_entry_t* lookupSegment(primegen_cache* cache, uint64_t index){
+
+    pthread_mutex_lock(&cache->lock);
+    cache_entry_t* entry = cache->buckets[bucketOf(cache, index)];
+    while(entry != NULL && entry->index != index){
+        entry = entry->hashNext;
+    }
+    if(entry != NULL){
+        entry->refs++;
+        unlinkLRU(cache, entry);
+        pushNewest(cache, entry);
+        cache->stats.hits++;
+    }else{
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+void releaseSegment(primegen_cache* cache, const cache_entry_t* entry){
+
+    pthread_mutex_lock(&cache->lock);
+    ((cache_entry_t*)entry)->refs--;
+    evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// stores a fully sieved segment, arr must cover the whole segment of the index
+void storeSegment(primegen_cache* cache, uint64_t index, const bool* arr){
+
+    if(cache->entryBytes > cache->capacity){
+        return;
+    }
+
+    // the bitmap is built before the lock is taken
+    cache_entry_t* entry = (cache_entry_t*)calloc(1, cache->entryBytes);
+    if(entry == NULL){
+        return;
+    }
+    entry->index = index;
+    for(size_t j = 0 ; j < cache->segmentSize / 2 ; j++){
+        entry->bits[j >> 6] |= (uint64_t)arr[2 * j + 1] << (j & 63);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    size_t bucket = bucketOf(cache, index);
+    cache_entry_t* existing = cache->buckets[bucket];
+    while(existing != NULL && existing->index != index){
+        existing = existing->hashNext;
+    }
+    // another thread may have stored the same segment in the meantime
+    if(existing != NULL){
+        pthread_mutex_unlock(&cache->lock);
+        free(entry);
+        return;
+    }
+    entry->hashNext = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    pushNewest(cache, entry);
+    cache->used += cache->entryBytes;
+    evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// decodes the numbers [low, high] of a cached segment into arr, arr[i] == true <=> low + i is prime
+void decodeSegment(const primegen_cache* cache, const cache_entry_t* entry, uint64_t low, uint64_t high, bool* arr){
+
+    uint64_t segLow = entry->index * cache->segmentSize;
+    for(uint64_t i = low - segLow ; i <= high - segLow ; i++){
+        // odd offsets are odd numbers because segLow is even
+        arr[i - (low - segLow)] = (i & 1) ? (entry->bits[i >> 7] >> ((i >> 1) & 63)) & 1 : false;
+    }
+    // 2 is the only even prime
+    if(low <= 2 && high >= 2){
+        arr[2 - low] = true;
+    }
+}
+
+int primegen_get_cache_stats(const primegen_ctx* ctx, primegen_cache_stats* stats){
+
+    if(ctx == NULL || stats == NULL || ctx->cache == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    pthread_mutex_lock(&ctx->cache->lock);
+    *stats = ctx->cache->stats;
+    stats->bytes = ctx->cache->used;
+    pthread_mutex_unlock(&ctx->cache->lock);
+    return PRIMEGEN_OK;
+}
@@ -0,0 +1,88 @@
+#include "config.h"
+
+// Compact binary format of ascending primes. Consecutive primes differ by an even gap (except 2 -> 3) and gaps
+// below 2^64 are shorter than 1552, so the halved gap fits into one varint byte for almost every prime and into
+// two bytes for all of them. The primes are framed in blocks with an absolute base and count, so a reader can
+// skip whole blocks by their size without decoding them.
+//
+// Block: base (u64) | count (u32) | payload bytes (u32) | count - 1 varints, all little endian.
+// A varint holds 7 bits per byte, the lowest group first, the high bit is set in every byte but the last.
+// The varint v encodes the gap 2v, or 2v + 1 if the previous prime is 2.
+
+static void storeLE(uint8_t* out, uint64_t value, int bytes){
+    for(int i = 0 ; i < bytes ; i++){
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t loadLE(const uint8_t* in, int bytes){
+    uint64_t value = 0;
+    for(int i = 0 ; i < bytes ; i++){
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+size_t primegen_delta_bound(size_t count){
+    // a varint of a 63 bit value takes at most 9 bytes
+    return PRIMEGEN_DELTA_HEADER + 9 * count;
+}
+
+size_t primegen_delta_encode(const uint64_t primes[], size_t count, uint8_t* out){
+
+    if(count == 0 || count > UINT32_MAX){
+        return 0;
+    }
+    uint8_t* p = out + PRIMEGEN_DELTA_HEADER;
+    for(size_t i = 1 ; i < count ; i++){
+        uint64_t v = (primes[i] - primes[i - 1]) >> 1;
+        // most gaps are below 256, the loop is only entered for the rest
+        while(v >= 0x80){
+            *p++ = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = (uint8_t)v;
+    }
+    size_t payload = (size_t)(p - out) - PRIMEGEN_DELTA_HEADER;
+    storeLE(out, primes[0], 8);
+    storeLE(out + 8, count, 4);
+    storeLE(out + 12, payload, 4);
+    return PRIMEGEN_DELTA_HEADER + payload;
+}
+
+int primegen_delta_peek(const uint8_t* in, size_t size, uint64_t* base, size_t* count, size_t* bytes){
+
+    if(size < PRIMEGEN_DELTA_HEADER){
+        return PRIMEGEN_EINVAL;
+    }
+    *base = loadLE(in, 8);
+    *count = (size_t)loadLE(in + 8, 4);
+    *bytes = PRIMEGEN_DELTA_HEADER + (size_t)loadLE(in + 12, 4);
+    return (*count == 0 || *bytes > size) ? PRIMEGEN_EINVAL : PRIMEGEN_OK;
+}
+
+size_t primegen_delta_decode(const uint8_t* in, size_t size, uint64_t primes[], size_t max, size_t* count){
+
+    uint64_t base;
+    size_t bytes;
+    if(primegen_delta_peek(in, size, &base, count, &bytes) != PRIMEGEN_OK || *count > max){
+        return 0;
+    }
+    const uint8_t* p = in + PRIMEGEN_DELTA_HEADER;
+    const uint8_t* end = in + bytes;
+    primes[0] = base;
+    for(size_t i = 1 ; i < *count ; i++){
+        uint64_t v = 0;
+        int shift = 0;
+        do{
+            if(p == end || shift > 56){
+                return 0;
+            }
+            v |= (uint64_t)(*p & 0x7f) << shift;
+            shift += 7;
+        }while(*p++ & 0x80);
+        primes[i] = primes[i - 1] + 2 * v + (primes[i - 1] == 2);
+    }
+    // the payload must end exactly with the last varint
+    return (p == end) ? bytes : 0;
+}
@@ -0,0 +1,180 @@
+#include "config.h"
+#include <sys/mman.h>
+
+// Lookup table that is filled on first access. Memory for all n primes is only reserved, nothing is sieved when
+// the table is created. The table is split into chunks of LAZY_CHUNK primes, a chunk is sieved by the range sieve
+// the first time one of its primes is needed, so the startup cost follows the primes that are actually used and
+// pages of chunks that are never needed are never touched.
+//
+// A chunk starts after the last prime of the chunk before it, so the chunks are filled in order and the filled
+// part is always a prefix. Every chunk has a once-flag (EMPTY -> FILLING -> READY): the thread that sets FILLING
+// sieves the chunk, threads that need the same chunk wait for it instead of sieving it twice. The size of the
+// filled prefix is published with release semantics after a chunk is written, so reads of filled chunks take one
+// acquire load and no lock. The lock is only taken by threads that wait for a chunk another thread fills.
+//
+// The filled prefix never changes, so views hand out pointers into it. Every view holds a reference, the table is
+// unmapped when the context and the last view have dropped theirs.
+
+#define LAZY_CHUNK      65536
+
+#define LAZY_EMPTY      0
+#define LAZY_FILLING    1
+#define LAZY_READY      2
+
+struct primegen_lazy_table {
+    uint64_t* primes;           // reserved for capacity primes, a page is committed when a chunk writes it
+    size_t capacity;
+    size_t mappingSize;
+    uint32_t* states;           // once-flag of every chunk
+    size_t ready;               // primes of the filled prefix, written with release and read with acquire semantics
+    size_t refs;                // the context and every view
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+};
+
+primegen_lazy_table* createLazyTable(size_t n){
+
+    if(n == 0 || n > SIZE_MAX / sizeof(uint64_t)){
+        return NULL;
+    }
+    primegen_lazy_table* lazy = (primegen_lazy_table*)calloc(1, sizeof(primegen_lazy_table));
+    if(lazy == NULL){
+        return NULL;
+    }
+    lazy->states = (uint32_t*)calloc((n + LAZY_CHUNK - 1) / LAZY_CHUNK, sizeof(uint32_t));
+    lazy->mappingSize = n * sizeof(uint64_t);
+    // the mapping is only reserved, MAP_NORESERVE keeps a large capacity from counting against the commit limit
+    void* mapping = mmap(NULL, lazy->mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(lazy->states == NULL || mapping == MAP_FAILED){
+        if(mapping != MAP_FAILED){
+            munmap(mapping, lazy->mappingSize);
+        }
+        free(lazy->states);
+        free(lazy);
+        return NULL;
+    }
+    lazy->primes = (uint64_t*)mapping;
+    lazy->capacity = n;
+    lazy->refs = 1;
+    pthread_mutex_init(&lazy->lock, NULL);
+    pthread_cond_init(&lazy->filled, NULL);
+    return lazy;
+}
+
+// drops one reference, the last one unmaps the table
+void releaseLazyTable(primegen_lazy_table* lazy){
+
+    if(lazy == NULL || __atomic_sub_fetch(&lazy->refs, 1, __ATOMIC_ACQ_REL) != 0){
+        return;
+    }
+    munmap(lazy->primes, lazy->mappingSize);
+    pthread_mutex_destroy(&lazy->lock);
+    pthread_cond_destroy(&lazy->filled);
+    free(lazy->states);
+    free(lazy);
+}
+
+void retainLazyTable(primegen_lazy_table* lazy){
+    __atomic_add_fetch(&lazy->refs, 1, __ATOMIC_RELAXED);
+}
+
+// primes that can be read without sieving, the filled prefix of the table is returned in primes
+size_t lazyReady(const primegen_lazy_table* lazy, const uint64_t** primes){
+
+    *primes = lazy->primes;
+    return __atomic_load_n(&lazy->ready, __ATOMIC_ACQUIRE);
+}
+
+typedef struct {
+    uint64_t* primes;
+    size_t count;
+    size_t remaining;
+} chunk_fill_t;
+
+static bool fillSegment(const primegen_segment* seg, void* arg){
+
+    chunk_fill_t* fill = (chunk_fill_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            fill->primes[fill->count++] = seg->low + i;
+            if(--fill->remaining == 0){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// sieves chunk c, the chunk before it must be filled
+static int fillChunk(const primegen_ctx* ctx, primegen_lazy_table* lazy, size_t c){
+
+    size_t first = c * LAZY_CHUNK;
+    size_t count = (lazy->capacity - first < LAZY_CHUNK) ? lazy->capacity - first : LAZY_CHUNK;
+    uint64_t low = 0;
+    if(c != 0){
+        if(lazy->primes[first - 1] == UINT64_MAX){
+            return PRIMEGEN_ERANGE;
+        }
+        low = lazy->primes[first - 1] + 1;
+    }
+    // the (first + count)th prime bounds the chunk, as in primegen_nth_prime()
+    uint64_t high = approximate(first + count);
+    chunk_fill_t fill = {lazy->primes + first, 0, count};
+    int status = sieveRange(ctx, low, (high < low) ? UINT64_MAX : high, fillSegment, &fill);
+    if(status == PRIMEGEN_OK && fill.remaining != 0){
+        status = PRIMEGEN_ERANGE;
+    }
+    return status;
+}
+
+// fills the table until it holds the first count primes, the table is returned in primes
+int fillLazyTable(const primegen_ctx* ctx, primegen_lazy_table* lazy, size_t count, const uint64_t** primes){
+
+    *primes = lazy->primes;
+    if(count > lazy->capacity){
+        return PRIMEGEN_ERANGE;
+    }
+
+    size_t ready;
+    while((ready = __atomic_load_n(&lazy->ready, __ATOMIC_ACQUIRE)) < count){
+        size_t c = ready / LAZY_CHUNK;
+        uint32_t expected = LAZY_EMPTY;
+        if(__atomic_compare_exchange_n(&lazy->states[c], &expected, LAZY_FILLING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+            int status = fillChunk(ctx, lazy, c);
+
+            // a failed chunk is handed back, the next caller tries again
+            pthread_mutex_lock(&lazy->lock);
+            if(status == PRIMEGEN_OK){
+                size_t end = (c + 1) * LAZY_CHUNK;
+                __atomic_store_n(&lazy->ready, (end < lazy->capacity) ? end : lazy->capacity, __ATOMIC_RELEASE);
+            }
+            __atomic_store_n(&lazy->states[c], (status == PRIMEGEN_OK) ? LAZY_READY : LAZY_EMPTY, __ATOMIC_RELEASE);
+            pthread_cond_broadcast(&lazy->filled);
+            pthread_mutex_unlock(&lazy->lock);
+            if(status != PRIMEGEN_OK){
+                return status;
+            }
+        }else{
+            // another thread fills the chunk, its state changes under the lock
+            pthread_mutex_lock(&lazy->lock);
+            while(__atomic_load_n(&lazy->states[c], __ATOMIC_ACQUIRE) == LAZY_FILLING){
+                pthread_cond_wait(&lazy->filled, &lazy->lock);
+            }
+            pthread_mutex_unlock(&lazy->lock);
+        }
+    }
+    return PRIMEGEN_OK;
+}
+
+// fills the table until its last filled prime is greater than x or the table is full
+int fillLazyTableTo(const primegen_ctx* ctx, primegen_lazy_table* lazy, uint64_t x, const uint64_t** primes){
+
+    size_t ready;
+    while((ready = lazyReady(lazy, primes)) < lazy->capacity && (ready == 0 || (*primes)[ready - 1] <= x)){
+        int status = fillLazyTable(ctx, lazy, ready + 1, primes);
+        if(status != PRIMEGEN_OK){
+            return status;
+        }
+    }
+    return PRIMEGEN_OK;
+}
@@ -0,0 +1,148 @@
+#include "config.h"
+#include <sys/mman.h>
+
+// Large buffers: prims[], the tables and the sieves of Versions 4 and 5 grow to several GB for n in the billions.
+// Buffers from LARGE_BUFFER bytes on are mapped directly instead of taken from malloc. Explicit huge pages
+// (MAP_HUGETLB) are tried first, otherwise the mapping is aligned to the huge page size and transparent huge pages
+// are requested by madvise. The pages are faulted in by several threads before the buffer is returned, every thread
+// touches its own contiguous part, so with the first touch NUMA policy each part lands on the node of its thread.
+// Every step may fail, the buffer falls back to normal pages, page faults on first use or malloc.
+//
+// A header in front of the buffer records how it was allocated, so freeLarge() only needs the pointer. The buffer
+// starts one cache line after the header, which keeps it aligned for the SIMD loads of prim_V8.
+
+#define LARGE_BUFFER            (64UL << 20)
+#define HUGE_PAGE               (2UL << 20)
+#define BUFFER_HEADER           64
+#define MAX_PREFAULT_THREADS    64
+
+#define BUFFER_HEAP             1
+#define BUFFER_MAPPED           2
+
+typedef struct {
+    uint64_t kind;          // BUFFER_HEAP or BUFFER_MAPPED
+    size_t size;            // size of the whole mapping, header included
+} buffer_header_t;
+
+typedef struct {
+    char* start;
+    size_t len;
+} prefault_part_t;
+
+static void* prefaultPart(void* arg){
+
+    prefault_part_t* part = (prefault_part_t*)arg;
+#ifdef MADV_POPULATE_WRITE
+    // one system call populates the whole part (Linux 5.14)
+    if(madvise(part->start, part->len, MADV_POPULATE_WRITE) == 0){
+        return NULL;
+    }
+#endif
+    // otherwise one write per page, the mapping is zero anyway
+    for(size_t i = 0 ; i < part->len ; i += 4096){
+        ((volatile char*)part->start)[i] = 0;
+    }
+    return NULL;
+}
+
+// faults the pages of [start, start + len) in by threads threads, the parts are aligned to huge pages
+static void prefault(char* start, size_t len, int threads){
+
+    if(threads > MAX_PREFAULT_THREADS){
+        threads = MAX_PREFAULT_THREADS;
+    }
+    size_t part = (len / threads + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    prefault_part_t parts[MAX_PREFAULT_THREADS];
+    pthread_t tids[MAX_PREFAULT_THREADS];
+    bool started[MAX_PREFAULT_THREADS] = {false};
+    int count = 0;
+    for(size_t offset = 0 ; offset < len && count < threads ; offset += part){
+        parts[count].start = start + offset;
+        parts[count].len = (len - offset < part) ? len - offset : part;
+        count++;
+    }
+
+    // the calling thread takes the first part itself, a part whose thread can not be started as well
+    for(int i = 1 ; i < count ; i++){
+        started[i] = (pthread_create(&tids[i], NULL, prefaultPart, &parts[i]) == 0);
+    }
+    prefaultPart(&parts[0]);
+    for(int i = 1 ; i < count ; i++){
+        if(started[i]){
+            pthread_join(tids[i], NULL);
+        }else{
+            prefaultPart(&parts[i]);
+        }
+    }
+}
+
+// maps size bytes aligned to the huge page size, NULL is returned on failure
+static char* mapHuge(size_t size){
+
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(mapping != MAP_FAILED){
+        return (char*)mapping;
+    }
+
+    // no explicit huge pages are reserved, transparent huge pages need an aligned mapping, which is cut out of a
+    // mapping that is one huge page larger
+    char* raw = (char*)mmap(NULL, size + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED){
+        return NULL;
+    }
+    char* aligned = (char*)(((uintptr_t)raw + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1));
+    if(aligned != raw){
+        munmap(raw, aligned - raw);
+    }
+    if(raw + HUGE_PAGE != aligned){
+        munmap(aligned + size, raw + HUGE_PAGE - aligned);
+    }
+    madvise(aligned, size, MADV_HUGEPAGE);
+    return aligned;
+}
+
+// allocates a buffer of size bytes that is released by freeLarge(). Large buffers are backed by huge pages and
+// prefaulted by threads threads (0 := all online processors), they are always zeroed. Smaller buffers come from
+// malloc, or from calloc if zeroed is set. NULL is returned if memory can not be allocated.
+void* allocateLarge(size_t size, bool zeroed, int threads){
+
+    if(size > SIZE_MAX - BUFFER_HEADER - HUGE_PAGE){
+        return NULL;
+    }
+    if(size >= LARGE_BUFFER){
+        size_t mapped = (size + BUFFER_HEADER + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        char* base = mapHuge(mapped);
+        if(base != NULL){
+            if(threads <= 0){
+                threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            }
+            prefault(base, mapped, (threads < 1) ? 1 : threads);
+            buffer_header_t* header = (buffer_header_t*)base;
+            header->kind = BUFFER_MAPPED;
+            header->size = mapped;
+            return base + BUFFER_HEADER;
+        }
+    }
+
+    char* base = zeroed ? (char*)calloc(1, size + BUFFER_HEADER) : (char*)malloc(size + BUFFER_HEADER);
+    if(base == NULL){
+        return NULL;
+    }
+    buffer_header_t* header = (buffer_header_t*)base;
+    header->kind = BUFFER_HEAP;
+    header->size = size + BUFFER_HEADER;
+    return base + BUFFER_HEADER;
+}
+
+void freeLarge(void* ptr){
+
+    if(ptr == NULL){
+        return;
+    }
+    buffer_header_t* header = (buffer_header_t*)((char*)ptr - BUFFER_HEADER);
+    if(header->kind == BUFFER_MAPPED){
+        munmap(header, header->size);
+    }else{
+        free(header);
+    }
+}
@@ -0,0 +1,406 @@
+#include "config.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+// Output of the prime numbers in the formats of -f. Text is formatted into a large buffer by hand instead of one
+// printf per prime, the delta format is encoded block by block by libprimegen.
+//
+// Output files of the raw and text formats are written through a shared mapping instead: the versions write the
+// raw primes straight into the mapped file, text is formatted into it while the range sieve runs. The file is
+// sized from an upper bound first and truncated to the exact size at the end, so neither a heap buffer of n primes
+// nor a copy through stdio exists.
+
+#define OUTPUT_BUFFER   65536
+
+// writes the decimal digits of x into buf, the number of digits is returned
+int formatNumber(char* buf, uint64_t x){
+
+    char digits[20];
+    int len = 0;
+    do{
+        digits[len++] = '0' + (char)(x % 10);
+        x /= 10;
+    }while(x != 0);
+    for(int i = 0 ; i < len ; i++){
+        buf[i] = digits[len - 1 - i];
+    }
+    return len;
+}
+
+static bool writeText(FILE* out, const uint64_t prims[], size_t count, int format){
+
+    char buf[OUTPUT_BUFFER];
+    size_t len = 0;
+    bool written = true;
+    if(format == OUTPUT_ARRAY){
+        buf[len++] = '[';
+    }
+    for(size_t i = 0 ; i < count && written ; i++){
+        // a number and its separator take at most 22 bytes
+        if(len > OUTPUT_BUFFER - 24){
+            written = (fwrite(buf, 1, len, out) == len);
+            len = 0;
+        }
+        len += formatNumber(buf + len, prims[i]);
+        if(format == OUTPUT_TEXT){
+            buf[len++] = '\n';
+        }else if(i + 1 < count){
+            buf[len++] = ',';
+            buf[len++] = ' ';
+        }
+    }
+    if(format == OUTPUT_ARRAY){
+        buf[len++] = ']';
+    }
+    return written && fwrite(buf, 1, len, out) == len;
+}
+
+typedef struct {
+    char* out;              // the mapped file
+    size_t len;             // bytes written so far
+    size_t remaining;       // primes that are still to be written
+} text_mapping_t;
+
+// maps the file path with a size of size bytes, NULL is returned on failure
+static void* mapFile(const char* path, size_t size){
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0){
+        return NULL;
+    }
+    void* mapping = MAP_FAILED;
+    if(size != 0 && ftruncate(fd, size) == 0){
+        mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    return (mapping == MAP_FAILED) ? NULL : mapping;
+}
+
+// maps the output file with room for n primes in the raw format, the versions write into the mapping directly
+uint64_t* mapPrims(const char* path, size_t n){
+
+    if(n > SIZE_MAX / sizeof(uint64_t)){
+        return NULL;
+    }
+    return (uint64_t*)mapFile(path, n * sizeof(uint64_t));
+}
+
+// frees prims of allocateLarge(), or unmaps it if it is the mapping of mapPrims()
+void releasePrims(uint64_t* prims, size_t n, bool mapped){
+
+    if(mapped){
+        munmap(prims, n * sizeof(uint64_t));
+    }else{
+        freeLarge(prims);
+    }
+}
+
+static bool formatSegment(const primegen_segment* seg, void* arg){
+
+    text_mapping_t* text = (text_mapping_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            text->len += formatNumber(text->out + text->len, seg->low + i);
+            text->out[text->len++] = '\n';
+            if(--text->remaining == 0){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// sieves the first n primes segment by segment and formats them as text straight into the mapped file path
+bool mapText(const char* path, size_t n){
+
+    // every prime has at most as many digits as the bound of the nth prime
+    char digits[20];
+    uint64_t bound = approximate(n);
+    size_t width = formatNumber(digits, bound) + 1;
+    if(n > SIZE_MAX / width){
+        fprintf(stderr,"Invalid Argument! Output file would be too large!\n");
+        return false;
+    }
+
+    primegen_ctx ctx;
+    if(primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    text_mapping_t text = {(char*)mapFile(path, n * width), 0, n};
+    if(text.out == NULL){
+        perror(path);
+        primegen_destroy(&ctx);
+        return false;
+    }
+    int status = sieveRange(&ctx, 0, bound, formatSegment, &text);
+    primegen_destroy(&ctx);
+
+    munmap(text.out, n * width);
+    if(truncate(path, text.len) != 0){
+        perror(path);
+        return false;
+    }
+    if(status != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    FILE* out;
+    char buf[OUTPUT_BUFFER];
+    size_t len;
+    size_t remaining;       // primes that are still to be written, SIZE_MAX for all of the range
+    bool written;
+} text_output_t;
+
+// appends x and a line break, the buffer is written out before it is full
+static void appendLine(text_output_t* text, unsigned __int128 x){
+
+    // a 128 bit number has at most 39 digits
+    if(text->len > OUTPUT_BUFFER - 48){
+        text->written = text->written && fwrite(text->buf, 1, text->len, text->out) == text->len;
+        text->len = 0;
+    }
+    if(x <= UINT64_MAX){
+        text->len += formatNumber(text->buf + text->len, (uint64_t)x);
+    }else{
+        char digits[40];
+        int len = 0;
+        for( ; x != 0 ; x /= 10){
+            digits[len++] = '0' + (char)(x % 10);
+        }
+        while(len > 0){
+            text->buf[text->len++] = digits[--len];
+        }
+    }
+    text->buf[text->len++] = '\n';
+    text->remaining--;
+}
+
+static bool formatProgression(const primegen_progression_segment* seg, void* arg){
+
+    text_output_t* text = (text_output_t*)arg;
+    for(size_t i = 0 ; i < seg->count && text->remaining != 0 ; i++){
+        if(seg->arr[i]){
+            appendLine(text, seg->first + i * seg->step);
+        }
+    }
+    return text->written && text->remaining != 0;
+}
+
+static bool formatWindow(const primegen_segment128* seg, void* arg){
+
+    text_output_t* text = (text_output_t*)arg;
+    for(unsigned __int128 i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            appendLine(text, seg->low + i);
+        }
+    }
+    return text->written;
+}
+
+// writes the primes p == a (mod m) in [low, high] as text, at most n of them
+bool writeProgression(FILE* out, uint64_t a, uint64_t m, uint64_t low, uint64_t high, size_t n){
+
+    primegen_ctx ctx;
+    text_output_t* text = (text_output_t*)malloc(sizeof(text_output_t));
+    if(text == NULL || primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        free(text);
+        return false;
+    }
+    text->out = out;
+    text->len = 0;
+    text->remaining = n;
+    text->written = true;
+    int status = primegen_progression(&ctx, a, m, low, high, formatProgression, text);
+    primegen_destroy(&ctx);
+
+    bool written = text->written && fwrite(text->buf, 1, text->len, out) == text->len && fflush(out) == 0;
+    free(text);
+    if(status != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    if(!written){
+        fprintf(stderr,"Prime numbers can not be written!\n");
+    }
+    return written;
+}
+
+// writes the primes in the window [low, high] as text, the window may reach beyond 2^64
+bool writeWindow(FILE* out, unsigned __int128 low, unsigned __int128 high){
+
+    primegen_ctx ctx;
+    text_output_t* text = (text_output_t*)malloc(sizeof(text_output_t));
+    if(text == NULL || primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        free(text);
+        return false;
+    }
+    text->out = out;
+    text->len = 0;
+    text->remaining = SIZE_MAX;
+    text->written = true;
+    int status = primegen_range128(&ctx, low, high, formatWindow, text);
+    primegen_destroy(&ctx);
+
+    bool written = text->written && fwrite(text->buf, 1, text->len, out) == text->len && fflush(out) == 0;
+    free(text);
+    if(status != PRIMEGEN_OK){
+        fprintf(stderr,(status == PRIMEGEN_ERANGE) ? "Invalid Argument! The window must be narrower than 2^64!\n" : "Memory can not be allocated!\n");
+        return false;
+    }
+    if(!written){
+        fprintf(stderr,"Prime numbers can not be written!\n");
+    }
+    return written;
+}
+
+// reads one number per line from in and writes pi of each, or the nth prime if nth is set, in the same order.
+// All numbers are answered as one batch.
+bool answerBatch(FILE* in, FILE* out, bool nth, int threads){
+
+    size_t count = 0;
+    size_t capacity = 1024;
+    uint64_t* queries = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    uint64_t x;
+    while(queries != NULL && fscanf(in, "%"SCNu64, &x) == 1){
+        if(count == capacity){
+            uint64_t* larger = (uint64_t*)realloc(queries, 2 * capacity * sizeof(uint64_t));
+            if(larger == NULL){
+                free(queries);
+                queries = NULL;
+                break;
+            }
+            queries = larger;
+            capacity *= 2;
+        }
+        queries[count++] = x;
+    }
+    if(queries != NULL && !feof(in)){
+        fprintf(stderr,"Invalid Argument! The queries must be numbers, one per line!\n");
+        free(queries);
+        return false;
+    }
+
+    primegen_tuning tuning = {0};
+    tuning.threads = threads;
+    primegen_ctx ctx;
+    uint64_t* answers = (queries != NULL) ? (uint64_t*)malloc((count + 1) * sizeof(uint64_t)) : NULL;
+    if(answers == NULL || primegen_init(&ctx, &tuning) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        free(queries);
+        free(answers);
+        return false;
+    }
+    int status = nth ? primegen_nth_prime_batch(&ctx, queries, count, answers) : primegen_pi_batch(&ctx, queries, count, answers);
+    primegen_destroy(&ctx);
+    free(queries);
+    if(status != PRIMEGEN_OK){
+        fprintf(stderr,(status == PRIMEGEN_ENOMEM) ? "Memory can not be allocated!\n" :
+            (status == PRIMEGEN_EINVAL) ? "Invalid Argument! n must be at least 1!\n" : "Invalid Argument! A prime number exceeds uint64_t!\n");
+        free(answers);
+        return false;
+    }
+
+    text_output_t* text = (text_output_t*)malloc(sizeof(text_output_t));
+    bool written = (text != NULL);
+    if(written){
+        text->out = out;
+        text->len = 0;
+        text->remaining = SIZE_MAX;
+        text->written = true;
+        for(size_t i = 0 ; i < count ; i++){
+            appendLine(text, answers[i]);
+        }
+        written = text->written && fwrite(text->buf, 1, text->len, out) == text->len && fflush(out) == 0;
+    }
+    if(!written){
+        fprintf(stderr,(text == NULL) ? "Memory can not be allocated!\n" : "Answers can not be written!\n");
+    }
+    free(text);
+    free(answers);
+    return written;
+}
+
+static bool writeDelta(FILE* out, const uint64_t prims[], size_t count){
+
+    uint8_t* block = (uint8_t*)malloc(primegen_delta_bound(PRIMEGEN_DELTA_BLOCK));
+    bool written = (block != NULL) && fwrite(PRIMEGEN_DELTA_MAGIC, 1, 8, out) == 8;
+    for(size_t i = 0 ; i < count && written ; i += PRIMEGEN_DELTA_BLOCK){
+        size_t size = primegen_delta_encode(&prims[i], (count - i < PRIMEGEN_DELTA_BLOCK) ? count - i : PRIMEGEN_DELTA_BLOCK, block);
+        written = (fwrite(block, 1, size, out) == size);
+    }
+    free(block);
+    return written;
+}
+
+// writes the first count primes in the given format
+bool writePrimes(FILE* out, const uint64_t prims[], size_t count, int format){
+
+    bool written;
+    if(format == OUTPUT_RAW){
+        written = (fwrite(prims, sizeof(uint64_t), count, out) == count);
+    }else if(format == OUTPUT_DELTA){
+        written = writeDelta(out, prims, count);
+    }else{
+        written = writeText(out, prims, count, format);
+    }
+    return fflush(out) == 0 && written;
+}
+
+// decodes a delta stream into text, one prime per line
+bool decodeDelta(FILE* in, FILE* out){
+
+    char magic[8];
+    if(fread(magic, 1, 8, in) != 8 || memcmp(magic, PRIMEGEN_DELTA_MAGIC, 8) != 0){
+        fprintf(stderr,"Input is not in the delta format!\n");
+        return false;
+    }
+
+    uint8_t* block = (uint8_t*)malloc(primegen_delta_bound(PRIMEGEN_DELTA_BLOCK));
+    uint64_t* prims = (uint64_t*)malloc(PRIMEGEN_DELTA_BLOCK * sizeof(uint64_t));
+    size_t capacity = PRIMEGEN_DELTA_BLOCK;
+    bool decoded = (block != NULL && prims != NULL);
+    if(!decoded){
+        fprintf(stderr,"Memory can not be allocated!\n");
+    }
+
+    size_t len;
+    while(decoded && (len = fread(block, 1, PRIMEGEN_DELTA_HEADER, in)) != 0){
+        uint64_t base;
+        size_t count;
+        size_t bytes;
+        // the header is peeked with the size it announces itself, only the payload is read afterwards
+        decoded = len == PRIMEGEN_DELTA_HEADER && primegen_delta_peek(block, SIZE_MAX, &base, &count, &bytes) == PRIMEGEN_OK;
+        if(decoded && count > capacity){
+            // blocks of other writers may be larger, the buffers grow with them
+            uint8_t* largerBlock = (uint8_t*)realloc(block, primegen_delta_bound(count));
+            block = (largerBlock != NULL) ? largerBlock : block;
+            uint64_t* largerPrims = (uint64_t*)realloc(prims, count * sizeof(uint64_t));
+            prims = (largerPrims != NULL) ? largerPrims : prims;
+            decoded = (largerBlock != NULL && largerPrims != NULL);
+            capacity = decoded ? count : capacity;
+        }
+        decoded = decoded && bytes <= primegen_delta_bound(count)
+            && fread(block + PRIMEGEN_DELTA_HEADER, 1, bytes - PRIMEGEN_DELTA_HEADER, in) == bytes - PRIMEGEN_DELTA_HEADER
+            && primegen_delta_decode(block, bytes, prims, capacity, &count) == bytes;
+        if(!decoded){
+            fprintf(stderr,"Delta stream is corrupt!\n");
+            break;
+        }
+        if(!writeText(out, prims, count, OUTPUT_TEXT)){
+            perror("Output can not be written");
+            decoded = false;
+        }
+    }
+    decoded = decoded && !ferror(in);
+    free(block);
+    free(prims);
+    return (fflush(out) == 0) && decoded;
+}
@@ -0,0 +1,210 @@
+#include "config.h"
+#include <sched.h>
+
+// Pipelined output of the first n primes. The calling thread sieves segment by segment and puts the primes of
+// every segment into a slot of a bounded ring, formatting threads take the slots in order, format them into their
+// own buffer and write the buffers in the order of the segments. Sieving and output overlap, the first bytes are
+// written after one segment and the whole run takes about as long as the slower of both stages.
+//
+// The ring is lock free (bounded queue of Dmitry Vyukov): the sequence of a slot tells whose turn it is. A slot
+// with sequence s is free for the producer of position s, with s + 1 it is full for the consumer of position s,
+// and the consumer hands it back with s + slots. Writing in order uses a ticket in the same way.
+
+#define PIPELINE_MAX_THREADS    8
+
+typedef struct {
+    uint64_t* primes;
+    size_t count;
+    size_t sequence;            // written with release and read with acquire semantics
+} pipeline_slot_t;
+
+typedef struct {
+    pipeline_slot_t* slots;
+    size_t slotCount;
+    size_t capacity;            // primes per slot, one segment at most
+    size_t producer;            // position of the next slot to fill, only used by the producer
+    size_t consumer;            // position of the next slot to take, taken by an atomic increment
+    size_t end;                 // number of slots in total, valid once done is set
+    bool done;
+    size_t turn;                // position of the slot whose buffer is written next
+    size_t remaining;           // primes that are still to be sieved
+    FILE* out;
+    int format;
+    bool failed;                // an allocation or a write failed, all threads stop
+} pipeline_t;
+
+// waits politely, the other stage is usually a segment away
+static void backoff(unsigned* spins){
+
+    const struct timespec pause = {0, 50000};
+    if(++*spins < 64){
+        sched_yield();
+    }else{
+        nanosleep(&pause, NULL);
+    }
+}
+
+static bool pipelineSegment(const primegen_segment* seg, void* arg){
+
+    pipeline_t* pipe = (pipeline_t*)arg;
+    pipeline_slot_t* slot = &pipe->slots[pipe->producer % pipe->slotCount];
+    unsigned spins = 0;
+    while(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pipe->producer){
+        if(__atomic_load_n(&pipe->failed, __ATOMIC_RELAXED)){
+            return false;
+        }
+        backoff(&spins);
+    }
+
+    slot->count = 0;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low && pipe->remaining != 0 ; i++){
+        if(seg->arr[i]){
+            slot->primes[slot->count++] = seg->low + i;
+            pipe->remaining--;
+        }
+    }
+    // empty segments are not passed on, a consumer would only wait for its turn
+    if(slot->count == 0){
+        return true;
+    }
+    __atomic_store_n(&slot->sequence, pipe->producer + 1, __ATOMIC_RELEASE);
+    pipe->producer++;
+    return pipe->remaining != 0;
+}
+
+// formats the primes of a slot into buf, the number of bytes is returned
+static size_t formatSlot(const pipeline_t* pipe, const pipeline_slot_t* slot, size_t position, char* buf){
+
+    size_t len = 0;
+    if(pipe->format == OUTPUT_RAW){
+        memcpy(buf, slot->primes, slot->count * sizeof(uint64_t));
+        return slot->count * sizeof(uint64_t);
+    }
+    if(pipe->format == OUTPUT_DELTA){
+        // every slot is one block, the stream header is written in front of the first one
+        if(position == 0){
+            memcpy(buf, PRIMEGEN_DELTA_MAGIC, 8);
+            len = 8;
+        }
+        return len + primegen_delta_encode(slot->primes, slot->count, (uint8_t*)buf + len);
+    }
+    for(size_t i = 0 ; i < slot->count ; i++){
+        if(pipe->format == OUTPUT_ARRAY && (position != 0 || i != 0)){
+            buf[len++] = ',';
+            buf[len++] = ' ';
+        }
+        len += formatNumber(buf + len, slot->primes[i]);
+        if(pipe->format == OUTPUT_TEXT){
+            buf[len++] = '\n';
+        }
+    }
+    return len;
+}
+
+static void* pipelineWorker(void* arg){
+
+    pipeline_t* pipe = (pipeline_t*)arg;
+    // a prime and its separator take at most 22 bytes, a delta block is smaller
+    size_t size = pipe->capacity * 22 + primegen_delta_bound(0) + 8;
+    char* buf = (char*)malloc(size);
+    if(buf == NULL){
+        __atomic_store_n(&pipe->failed, true, __ATOMIC_RELAXED);
+    }
+
+    while(!__atomic_load_n(&pipe->failed, __ATOMIC_RELAXED)){
+        size_t position = __atomic_fetch_add(&pipe->consumer, 1, __ATOMIC_RELAXED);
+        pipeline_slot_t* slot = &pipe->slots[position % pipe->slotCount];
+
+        // the slot is full once its sequence moves on, unless the producer is done before this position
+        unsigned spins = 0;
+        bool full = false;
+        while(!(full = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == position + 1)){
+            if(__atomic_load_n(&pipe->done, __ATOMIC_ACQUIRE) && position >= pipe->end){
+                break;
+            }
+            if(__atomic_load_n(&pipe->failed, __ATOMIC_RELAXED)){
+                break;
+            }
+            backoff(&spins);
+        }
+        if(!full){
+            break;
+        }
+
+        size_t len = formatSlot(pipe, slot, position, buf);
+        __atomic_store_n(&slot->sequence, position + pipe->slotCount, __ATOMIC_RELEASE);
+
+        // the buffers are written in the order of the segments
+        spins = 0;
+        while(__atomic_load_n(&pipe->turn, __ATOMIC_ACQUIRE) != position){
+            if(__atomic_load_n(&pipe->failed, __ATOMIC_RELAXED)){
+                break;
+            }
+            backoff(&spins);
+        }
+        if(__atomic_load_n(&pipe->failed, __ATOMIC_RELAXED) || fwrite(buf, 1, len, pipe->out) != len){
+            __atomic_store_n(&pipe->failed, true, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&pipe->turn, position + 1, __ATOMIC_RELEASE);
+    }
+    free(buf);
+    return NULL;
+}
+
+// writes the first n primes in the given format into out, sieving and output run in threads + 1 threads
+bool pipePrimes(size_t n, FILE* out, int format, int threads){
+
+    primegen_ctx ctx;
+    if(primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    if(threads > PIPELINE_MAX_THREADS){
+        threads = PIPELINE_MAX_THREADS;
+    }
+
+    // two slots per worker, so every worker can format one while the producer fills the next
+    pipeline_t pipe;
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.slotCount = 2 * threads;
+    pipe.capacity = ctx.tuning.segmentSize / 2 + 1;
+    pipe.remaining = n;
+    pipe.out = out;
+    pipe.format = format;
+    pipe.slots = (pipeline_slot_t*)calloc(pipe.slotCount, sizeof(pipeline_slot_t));
+    bool allocated = (pipe.slots != NULL);
+    for(size_t i = 0 ; i < pipe.slotCount && allocated ; i++){
+        pipe.slots[i].sequence = i;
+        pipe.slots[i].primes = (uint64_t*)malloc(pipe.capacity * sizeof(uint64_t));
+        allocated = (pipe.slots[i].primes != NULL);
+    }
+
+    pthread_t tids[PIPELINE_MAX_THREADS];
+    int started = 0;
+    while(allocated && started < threads && pthread_create(&tids[started], NULL, pipelineWorker, &pipe) == 0){
+        started++;
+    }
+
+    int status = PRIMEGEN_ENOMEM;
+    if(started != 0){
+        status = sieveRange(&ctx, 0, approximate(n), pipelineSegment, &pipe);
+    }else{
+        pipe.failed = true;
+    }
+    pipe.end = pipe.producer;
+    __atomic_store_n(&pipe.done, true, __ATOMIC_RELEASE);
+    for(int i = 0 ; i < started ; i++){
+        pthread_join(tids[i], NULL);
+    }
+
+    bool success = (status == PRIMEGEN_OK && !pipe.failed && fflush(out) == 0);
+    if(!success){
+        fprintf(stderr,(status != PRIMEGEN_OK || !allocated) ? "Memory can not be allocated!\n" : "Prime numbers can not be written!\n");
+    }
+    for(size_t i = 0 ; i < pipe.slotCount && pipe.slots != NULL ; i++){
+        free(pipe.slots[i].primes);
+    }
+    free(pipe.slots);
+    primegen_destroy(&ctx);
+    return success;
+}
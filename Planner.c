@@ -0,0 +1,85 @@
+#include "config.h"
+
+// Crossovers between the versions, measured with -B on our own computers (gcc -O2). Version 2 is the fastest one
+// for very small n because it does not allocate anything besides prims[], Version 5 as long as its whole sieve
+// fits into one segment of Version 0 and Version 0 for everything above that. Versions 1, 3, 4 and 6 have never
+// been the fastest in any measurement, Versions 7 and 8 need a table that has to be created by Version 0 first.
+// Versions 4 and 5 sieve and extract their blocks on several threads, but the crossovers were measured on a single
+// processor, where Version 5 is faster than before only for small n. The thread count does not move them yet.
+static const struct {
+    size_t maxN;    // the version is the fastest one up to (and including) maxN
+    int version;
+} crossovers[] = {
+    {25,       2},
+    {53228,    5},
+    {SIZE_MAX, 0},
+};
+
+// if the fastest version does not fit into the memory budget, the next one of this list that fits is selected.
+// Version 2 only needs prims[] itself and therefore fits whenever the result fits.
+static const int fallbacks[] = {0, 5, 2};
+
+// multiplication that saturates at SIZE_MAX instead of overflowing, so huge n can not produce small estimations.
+static size_t mulSat(size_t a, size_t b){
+    if(b != 0 && a > SIZE_MAX / b){
+        return SIZE_MAX;
+    }
+    return a * b;
+}
+
+static size_t addSat(size_t a, size_t b){
+    return (a > SIZE_MAX - b) ? SIZE_MAX : a + b;
+}
+
+// estimation of the peak memory in bytes a version needs to calculate the first n primes, prims[] included.
+size_t planMemory(int version, size_t n){
+
+    size_t result = mulSat(n, sizeof(uint64_t));
+    uint64_t untill = approximate(n);
+    size_t sieve = (untill >= SIZE_MAX) ? SIZE_MAX : (size_t)untill + 1;
+
+    switch(version){
+        case 0:
+            // small n are delegated to Version 5, otherwise two boolean arrays of the segment size are used
+            if(untill <= 655359 || n <= 53228){
+                return addSat(result, sieve);
+            }
+            return addSat(result, 2 * 655360);
+        case 4:
+        case 5:
+        case 6:
+            return addSat(result, sieve);
+        case 7:
+        case 8:
+            // the table is as large as prims[] and is created by Version 0
+            return addSat(result, planMemory(0, n));
+        default:
+            return result;
+    }
+}
+
+// selects the fastest version for the first n primes that fits into the memory budget in bytes (0 := no budget).
+// -1 is returned if not even prims[] fits into the budget.
+int planVersion(size_t n, int threads, size_t budget){
+
+    (void)threads;
+
+    int preferred = 0;
+    for(size_t i = 0 ; i < sizeof(crossovers) / sizeof(crossovers[0]) ; i++){
+        if(n <= crossovers[i].maxN){
+            preferred = crossovers[i].version;
+            break;
+        }
+    }
+
+    if(budget == 0 || planMemory(preferred, n) <= budget){
+        return preferred;
+    }
+
+    for(size_t i = 0 ; i < sizeof(fallbacks) / sizeof(fallbacks[0]) ; i++){
+        if(planMemory(fallbacks[i], n) <= budget){
+            return fallbacks[i];
+        }
+    }
+    return -1;
+}
@@ -1,80 +1,149 @@
 #include "config.h"
 
-// approximation function for nth prime
+// upper bound for the nth prime number. The bounds are proven (Rosser 1941, Dusart 1999/2010), so the sieve sizes derived
+// from them are always large enough and no extra padding is needed.
+//   p_n <= n * (ln n + ln ln n)                                 for n >= 6
+//   p_n <= n * (ln n + ln ln n - 0.9484)                        for n >= 39017
+//   p_n <= n * (ln n + ln ln n - 1 + (ln ln n - 2) / ln n)      for n >= 688383
 uint64_t approximate(size_t n) {
- 
-    // if n is too small, no need to approximate an upper bound
-    if(n < 7){
-        return 20;
-    }
-    //     9223372036854775808 := size_t_max 
-    //     18446744073709551557:= largest prime number less than 2^64
-    //     37022029335820970   := estimation of how many prime numbers there can be before the largest
-    //                            prime number less than 2^64 := n_max
-    //  estimation comes from  := x ≈ x/ln(x)
-
-    // In order to make the approximation work in every case, we calculate at least until UINT64_MAX if then given n > n_max
-    if(n > 37022029335820970){
-        return UINT64_MAX - 1;
+
+    // first primes are returned exactly, the bounds only hold from n = 6 on
+    static const uint64_t first[] = {2, 2, 3, 5, 7, 11};
+    if(n < 6){
+        return first[n];
     }
 
-    // approximation function
-    uint64_t res = ceil(n * (log(n) + log(log(n)) - 1 + ((log(log(n))-2)/log(n)) - 
-    ((pow(log(log(n)),2) - (6*log(log(n))) + 11)/(2*pow(log(n),2))) + (1/(pow(log(n),2)))));
+    // long double is used because its 64 bit mantissa keeps the rounding error of the bound below a few units
+    // even near 2^64.
+    long double ln = logl((long double)n);
+    long double lnln = logl(ln);
+    long double bound;
+    if(n < 39017){
+        bound = n * (ln + lnln);
+    }else if(n < 688383){
+        bound = n * (ln + lnln - 0.9484L);
+    }else{
+        bound = n * (ln + lnln - 1 + (lnln - 2) / ln);
+    }
 
-    // if approximation so close to uint64_max, then we should leave a bit gap between them
-    // so there can not be an overflow for the approximation
-    if(res > UINT64_MAX - 1000){
-        uint64_t temp = res - 1000;
-        temp++;
-        res -= temp;
+    // a margin of 2^-40 of the bound covers the remaining rounding error.
+    bound += bound / 1099511627776.0L + 2;
+
+    // 425656284035217743 := pi(2^64), there are no more primes that can be represented in 64 bits.
+    // In order to make the approximation work in every case, we calculate until UINT64_MAX - 1 if the bound exceeds
+    // it, so callers allocating (bound + 1) elements can not overflow.
+    if(bound >= (long double)(UINT64_MAX - 1)){
+        return UINT64_MAX - 1;
     }
 
-    return res + 1000;
+    return (uint64_t)ceill(bound);
 }
 
-//  table is created here, but since malloc etc. can not be used to create a global variable, table MUST be
-//  initialised before used. Than can be done via createTable() method. Table is initialised via malloc()
-//  and can be used afterwards. The size of the table should be determined by the user. There is no need to
-//  always create a table consisting all the primes untill 2^64, the table should be created for user's needs.  
+//  The table is not a global variable, it is owned by its caller (see primegen_create_table() for the context
+//  of the library). The size of the table should be determined by the user. There is no need to always create
+//  a table consisting all the primes untill 2^64, the table should be created for user's needs.
 
 // First n prime numbers are found and written on a table(pointer) via Segmented Sieve of Eratosthenes and the table is returned.
-uint64_t* createTable(size_t n) {
+// The number of primes in the table is written into total, it can be less than n because there is a limited number of primes
+// that can be represented in 64 bit unsigned. NULL is returned if memory can not be allocated, the table is released
+// by freeLarge().
+uint64_t* createTable(size_t n, size_t* total) {
 
-    table = (uint64_t*)malloc(n * sizeof(uint64_t));
+    if (n > SIZE_MAX / sizeof(uint64_t)) {
+        return NULL;
+    }
+    uint64_t* table = (uint64_t*)allocateLarge(n * sizeof(uint64_t), false, 0);
     if (table == NULL) {
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
+        return NULL;
     }
     // segmented Sieve is used to create the table since segmented Sieve is selected as our main implementation because of memory allocation reasons.
-    size_t total = prim(n, table);
-    // printing total number of primes makes sense because there is a constant number of primes that can be represented in 64 bit unsigned. If the limit is exceeded
-    // user can be aware of that.
-    printf("\nThe program was asked to create a table consisting of %zu prime numbers.\n", n);
-    printf("Total of %zu prime numbers are in the table.\n", total);
-    if (n > total) {
-        printf("Total number of primes that can be represented in uint64_t has a limit, therefore table has less elements than desired. The difference is %zu.\n\n", n - total);
-    }
-    printf("The infos printed untill here are regarding the table creation method. Copying from table to prims[] will start as soon as this message is printed.\n\n");
+    *total = prim(n, table);
+    if (*total == 0 && n != 0) {
+        freeLarge(table);
+        return NULL;
+    }
     return table;
 
 }
 
-// naive prime number checker
+// Odd primes below 2^16 with their inverses modulo 2^64 for trial division. If q is the inverse of an odd p
+// (p * q == 1 mod 2^64), n * q runs through the multiples of p first, so p divides n exactly if
+// n * q <= (2^64 - 1) / p. A trial division then costs one multiplication instead of a hardware division.
+// The table is built once on first use and only read afterwards, so threads share it without locking.
+#define DIVISOR_LIMIT   65536
+#define DIVISOR_COUNT   6541
+
+typedef struct {
+    uint64_t inverse;
+    uint64_t limit;     // (2^64 - 1) / prime
+    uint32_t prime;
+} divisor_t;
+
+static divisor_t divisors[DIVISOR_COUNT];
+static pthread_once_t divisorsOnce = PTHREAD_ONCE_INIT;
+
+static void buildDivisors(void){
+
+    bool composite[DIVISOR_LIMIT] = {false};
+    size_t count = 0;
+    for(uint32_t p = 3 ; p < DIVISOR_LIMIT ; p += 2){
+        if(composite[p]){
+            continue;
+        }
+        for(uint32_t j = p * p ; j < DIVISOR_LIMIT ; j += 2 * p){
+            composite[j] = true;
+        }
+        // p is its own inverse modulo 8, every Newton step doubles the number of correct bits (3 -> 96)
+        uint64_t inverse = p;
+        for(int i = 0 ; i < 5 ; i++){
+            inverse *= 2 - p * inverse;
+        }
+        divisors[count].inverse = inverse;
+        divisors[count].limit = UINT64_MAX / p;
+        divisors[count].prime = p;
+        count++;
+    }
+}
+
+// trial division of an odd n by the table from index first on. 1 is returned if n is prime, 0 if it is composite
+// and -1 if the table ends before the square root of n.
+static int tableDivision(uint64_t n, size_t first){
+
+    pthread_once(&divisorsOnce, buildDivisors);
+    for(size_t i = first ; i < DIVISOR_COUNT ; i++){
+        const divisor_t* d = &divisors[i];
+        // the square is compared first, so a prime of the table is not divided by itself
+        if((uint64_t)d->prime * d->prime > n){
+            return 1;
+        }
+        if(n * d->inverse <= d->limit){
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// trial division prime checker, the odd primes of the table are tried first and every odd number afterwards
 bool checkPrime(uint64_t n){
 
-    bool isPrime = true;
-    uint64_t limit = sqrt(n);
+    if(n < 4){
+        return n >= 2;
+    }
+    if(n % 2 == 0){
+        return false;
+    }
+    int result = tableDivision(n, 0);
+    if(result >= 0){
+        return result;
+    }
 
-    // enough to check until the square root of the given number 
-    for(uint64_t i = 2 ; i <= limit ; i++){
-        // n should only be divided by 1 and itself with rest 0
+    // only numbers above 2^32 get here, hardware division is used beyond the table
+    for(uint64_t i = DIVISOR_LIMIT + 1 ; i <= n / i ; i += 2){
         if(n % i == 0){
-            isPrime = false;
-            break;
+            return false;
         }
     }
-return isPrime;
+    return true;
 }
 
 // 6k±1 theorem, no need to iterate each number
@@ -94,9 +163,15 @@ bool checkPrime_V2(uint64_t n){
         return false;
     }
 
-    uint64_t k = sqrt(n);
-    // 6k±1 theorem, if the number is multiple of 6k±1(a prime number) for a certain k, then it can not be prime
-    for (uint64_t i = 5 ; i <= k ; i += 6){
+    // 3 is already checked, the table continues with 5
+    int result = tableDivision(n, 1);
+    if(result >= 0){
+        return result;
+    }
+
+    // 6k±1 theorem beyond the table, if the number is multiple of 6k±1(a prime number) for a certain k, then it
+    // can not be prime. 65537 = 6k-1 is the first candidate after the table.
+    for (uint64_t i = DIVISOR_LIMIT + 1 ; i <= n / i ; i += 6){
         if (n % i == 0 || n % (i + 2) == 0){
             return false;
         }
@@ -104,55 +179,114 @@ bool checkPrime_V2(uint64_t n){
     return true;
 }
 
-// Miller-Rabin primality test 
-// !! ONLY checkPrime_V3 (miller-rabin test) IS NOT IMPLEMENTED BY US !!
-// source-code : https://de.wikipedia.org/wiki/Miller-Rabin-Test
-// Used to make comparisons(time&correctness) between other algorithms/versions that are implemented by us
-bool checkPrime_V3(uint64_t n, uint64_t a){
+// Montgomery arithmetic modulo an odd n with R = 2^64. A number a is kept as a * R mod n, so a product modulo n
+// takes two 64x64 bit multiplications instead of a 128 bit division.
+typedef struct {
+    uint64_t n;
+    uint64_t inverse;   // n^-1 mod 2^64
+    uint64_t one;       // R mod n
+    uint64_t d;         // n - 1 = d * 2^e with d odd
+    int e;
+} montgomery_t;
+
+static void montgomeryInit(montgomery_t* m, uint64_t n){
+
+    m->n = n;
+    // n is its own inverse modulo 8, every Newton step doubles the number of correct bits
+    m->inverse = n;
+    for(int i = 0 ; i < 5 ; i++){
+        m->inverse *= 2 - n * m->inverse;
+    }
+    m->one = (UINT64_MAX % n + 1) % n;
+    m->d = n - 1;
+    m->e = 0;
+    while((m->d & 1) == 0){
+        m->d >>= 1;
+        m->e++;
+    }
+}
+
+// a * b / R mod n for a, b < n. q * n has the same low half as a * b, so the difference is a multiple of R and
+// only the high halves have to be subtracted.
+static inline uint64_t montgomeryMul(uint64_t a, uint64_t b, const montgomery_t* m){
+
+    unsigned __int128 t = (unsigned __int128)a * b;
+    uint64_t q = (uint64_t)t * m->inverse;
+    uint64_t h = (uint64_t)(((unsigned __int128)q * m->n) >> 64);
+    uint64_t high = (uint64_t)(t >> 64);
+    return (high >= h) ? high - h : high - h + m->n;
+}
+
+// one strong probable prime test of the odd n of m to base a
+static bool strongProbablePrime(const montgomery_t* m, uint64_t a){
 
-    uint64_t m = n - 1;
-    uint64_t d = m >> 1, e = 1;
-    while(!(d & 1)) {
-        d >>= 1;
-        ++e;
+    a %= m->n;
+    if(a == 0){
+        return true;
     }
-    uint64_t p = a , q = a;
-    while(d >>= 1){
-        q *= q;
-        q %= n;
-        if(d & 1) p *= q, p %= n;
+    uint64_t minusOne = m->n - m->one;
+    a = (uint64_t)(((unsigned __int128)a << 64) % m->n);
+    uint64_t x = m->one;
+    for(uint64_t k = m->d ; k != 0 ; k >>= 1){
+        if(k & 1){
+            x = montgomeryMul(x, a, m);
+        }
+        a = montgomeryMul(a, a, m);
     }
-
-    if(p == 1 || p == m){
+    if(x == m->one || x == minusOne){
         return true;
     }
-
-    while(--e){
-        p *= p , p %= n;
-        if(p == m) return true;
-        if (p <= 1) break;
+    for(int e = m->e ; --e > 0 ; ){
+        x = montgomeryMul(x, x, m);
+        if(x == minusOne){
+            return true;
+        }
     }
     return false;
 }
 
-void SieveOfAtkin(size_t z, uint64_t prims[z],uint64_t limit){
+// deterministic Miller-Rabin test for all 64 bit numbers. The products are reduced by Montgomery multiplication,
+// so the test is correct above 2^32 as well. The 7 bases of Jim Sinclair are enough for n < 2^64.
+bool checkPrime_V4(uint64_t n){
+
+    if(n < 64){
+        return (0x28208a20a08a28acULL >> n) & 1;
+    }
+    if(n % 2 == 0 || n % 3 == 0 || n % 5 == 0 || n % 7 == 0){
+        return false;
+    }
+
+    montgomery_t m;
+    montgomeryInit(&m, n);
+    static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    for(size_t i = 0 ; i < sizeof(bases) / sizeof(bases[0]) ; i++){
+        if(!strongProbablePrime(&m, bases[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+// false is returned if memory can not be allocated
+bool SieveOfAtkin(size_t z, uint64_t prims[z],uint64_t limit){
 
     // we mark each element false in sieve ptr/array
-    bool* sievePTR = (bool*) calloc(limit, sizeof(char));
+    bool* sievePTR = (bool*) calloc(limit + 1, sizeof(char));
     if (sievePTR == NULL) {
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
+        return false;
     }
     
     if(z == 1){
         prims[0] = 2;
-        return;
+        free(sievePTR);
+        return true;
     }
 
     if(z == 2){
         prims[0] = 2;
         prims[1] = 3;
-        return;
+        free(sievePTR);
+        return true;
     }
 
     // getting square root of the limit 
@@ -215,16 +349,18 @@ void SieveOfAtkin(size_t z, uint64_t prims[z],uint64_t limit){
             count++;
         }
     }
+    free(sievePTR);
+    return true;
 }
 
 // This is the Sieve of Erast. Algorithm without any approximation. Only calculates the prime numbers until n, does not calculate n prime numbers.
 // This is needed for segmented Sieve of Erast. and there implemented. A boolean array is used and SIMD is used to fasten this process. 
+// 0 is returned if memory can not be allocated.
 size_t sOE(size_t n, uint64_t prims[n]) {
 
     bool* boolArr = (bool*)malloc((n+1) * sizeof(bool));
     if(boolArr == NULL){
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
+        return 0;
     }
 
     // Helper will be copied to boolArr to initiliase its boolean values. All of the even indexes are marked as false
@@ -232,8 +368,8 @@ size_t sOE(size_t n, uint64_t prims[n]) {
 
     bool* helper = (bool*) malloc(16 * sizeof(bool));
     if(helper == NULL){
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
+        free(boolArr);
+        return 0;
     }
 
     *(helper+0)  = false;
@@ -260,6 +396,7 @@ size_t sOE(size_t n, uint64_t prims[n]) {
     for (size_t i = 0; i < n / 16; i+=1) {
         boolArr_vec[i] = _mm_loadu_si128(helper_vec);
     }
+    free(helper);
     // % is done outside the loop because in worst case there needs to be more than 1 modula op. to be made, but with that
     // it is sure that modulo will be used only for 1 time in the worst case. The compiler will probably optimise this by itself
     // but better safe than sorry. 
@@ -293,6 +430,7 @@ size_t sOE(size_t n, uint64_t prims[n]) {
             index++;
         }
     }
+    free(boolArr);
     return index;
 }
 
@@ -318,515 +456,456 @@ size_t prim(size_t n, uint64_t prims[n]) {
     uint64_t segmentSize = 655359; 
 
     // If numberOfNumbersToBeChecked are <= segment size, there is no need of segmentation.
+    // The first segment is sieved by sOE directly into prims[], so prims[] must be able to hold all of its
+    // pi(655359) = 53228 primes as well. Below that the tight bound can still exceed the segment size.
     size_t numberOfNumbersToBeChecked = approximate(n);
-    if (numberOfNumbersToBeChecked <= segmentSize) {
+    if (numberOfNumbersToBeChecked <= segmentSize || n <= 53228) {
         segmentSize = n;
         return prim_V5(segmentSize, prims);
     }
 
-    // firstArr is the segment which will help to find other primes and first segment sieved by the sOE, Sieve of Erat. but without any
-    // approximation function, it calcualtes all the primes until the parameter-given size_t n.
-    size_t firstArrSize = sOE(segmentSize, prims);
-    size_t index = firstArrSize;
+    // the first segment is sieved by sOE, Sieve of Erat. but without any approximation function, it calculates all
+    // the primes until segmentSize straight into prims[].
+    // 0 is returned if memory can not be allocated, the caller decides how to report it.
+    size_t index = sOE(segmentSize, prims);
+    if (index == 0) {
+        return 0;
+    }
+
+    // The sieving primes are kept apart from prims[] as 32 bit numbers and go until the square root of the bound of
+    // the nth prime. The primes of the first segment alone would only be enough until 655359^2 (about 4.3 * 10^11).
+    uint32_t* sieving;
+    size_t sievingCount = sievingPrimes(isqrt(numberOfNumbersToBeChecked), &sieving);
+    if (sievingCount == SIZE_MAX) {
+        return 0;
+    }
 
-    // Segmentation starts here.
-    // low is the smallest number to be checked in the segment.
-    // high is the highest number to be checked in the segment;
-    uint64_t low = segmentSize;
-    uint64_t high = 2 * segmentSize;
     // segment is allocated here and always used the same memory for each segment, since at the end of sieving, primes found are saved in prims[].
     bool *arr = (bool*)malloc(segmentSize+1);
     if (arr == NULL) {
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
-    }
-   
-    while (true) {
-        memset(arr, true, segmentSize+1); 
-        for (size_t i = 0; i < firstArrSize; i++) {
-            // startValues are calculated through the first segment that is sieved. Via that segment, multiplicatives of these primes are found and eliminated.
-            uint64_t startValue = floor(low/prims[i]) * prims[i];
-            if (startValue < low)
-                startValue += prims[i];
-            for (size_t j=startValue; j<=high; j+=prims[i]) {
-                arr[j-low] = false;
-            }
-        }
-        // found primes in segment are saved in prims[].
-        for (size_t i = low; i<=high; i++) {
-            if (arr[i - low] == true) {
-                prims[index] = i;
-                index++;
-                if (index == n) {
-                    break;
-                }
-            }
-        }
-        if (index == n) {
-            return index;  
-        }
-        // increment the low and high to search for the next segment.
-        // segmentSize +1 because for example if the segment size was 10, and we start with the interval [10-20] then by incrementing 1
-        // the segmentation goes on for [21-31]. Total of numbers checked in interval stays the same but there is no need to check 20 twice in our example.
-        // if 20 was a prime number it would have been checked twice and can be written two times in the table. Therefore also incrementing by 1 makes sense.
-        low += segmentSize +1;
-        high+= segmentSize +1;
-        // If the high overflows and 64 bit limit is exceeded, then the last segment to be sieved has come. The sieving of the last segment are handled below.
-        // It needs to be written as a different case because altough it seems very similar, control for overflows has to be done. 
-        // !!! 
-        // The overflow controls are done only in the last segment because in our tests our segment size was 294911 byte for which it is enough to control
-        // the last segment. However the segment size of the Rechnerhalle is too big but still we did not think that it will be necessary but since we can not test
-        // these numbers because computation time takes weeks, we could not have the chance to test our theory. 
-        // !!!
-        if (high < segmentSize) { // overflow check
-            high = UINT64_MAX;
-            break;
-        }
+        free(sieving);
+        return 0;
     }
 
-    // Sieving last segment will be done in a seperate part because there must be control made for index 
-    // if it overflows and exceeds the limits of uint64_t
-
-    uint64_t tmp;
+    // Segmentation starts here.
+    // low is the smallest number to be checked in the segment.
+    // high is the highest number to be checked in the segment, the last segment ends at UINT64_MAX.
+    // sieveSegment() calculates with offsets relative to low, so nothing overflows in the last segment either.
+    uint64_t low = segmentSize + 1;
+    while (index < n) {
+        uint64_t high = (low > UINT64_MAX - segmentSize) ? UINT64_MAX : low + segmentSize;
+        sieveSegment(low, high, arr, sieving, sievingCount);
 
-    memset(arr, true, segmentSize+1); 
-    for (size_t i = 0; i < firstArrSize; i++) {
-        uint64_t startValue = floor(low/prims[i]) * prims[i];
-        // startValue calculation will not cause overflow becase the biggest prime number that have been accessed will be from the first sieved segment, therefore
-        // the computation will not result in overflow.
-        if (startValue < low) {
-            tmp = startValue;
-            tmp += prims[i];
-            // First overflow check. Only increase if incrementing does not result in overflow.
-            if (tmp >= startValue) {
-                startValue += prims[i];
+        // found primes in segment are saved in prims[].
+        for (uint64_t i = 0; i <= high - low && index < n; i++) {
+            if (arr[i] == true) {
+                prims[index++] = low + i;
             }
         }
-        for (uint64_t j=startValue; j<=high; j+=prims[i]) {
-            // if adding prims[i] cause overflow, break the loop because all the other incrementations will also result in overflow
-            // and continue with next element. 
-            if (j < startValue)
-                break;
-            arr[j-low] = false;
-        }
-    }
-    for (uint64_t i = low; i<=high; i++) {
-        if (arr[i - low] == true) {
-            prims[index] = i;
-            index++;
-            if (index == n) {
-                break;
-            }
+        if (high == UINT64_MAX) {
+            break;
         }
+        low = high + 1;
     }
+    free(arr);
+    free(sieving);
     return index;
-    // Sieving last segment ends here
 }
 
-// basic with brute force&trial division prime checker
+// basic with brute force&trial division prime checker, only odd numbers are checked after 2
 size_t prim_V1(size_t n, uint64_t prims[n]){
 
     if(n == 0){
         return 0;
     }
-    else{
-        prims[0] = 2;
-    
-        if(n == 1) { return 1;}
-
-        else if(n == 2) {prims[1] = 3;}
-
-        // n > 2
-        else{
-            prims[1] = 3;
-            uint64_t num = 5;
-            int index = 2;
-            size_t count = 2;
-
-            while(count < n){
+    prims[0] = 2;
+    size_t count = 1;
 
-                if(num == UINT64_MAX){
-                    return n;
-                }
-                if(checkPrime(num)){
-                    count++;
-                    prims[index++] = num;
-                }
-                num++;
-            }
+    // UINT64_MAX is odd and composite, the loop ends there
+    for(uint64_t num = 3 ; count < n && num != UINT64_MAX ; num += 2){
+        if(checkPrime(num)){
+            prims[count++] = num;
         }
     }
-    return n;
+    return count;
 }
 
-// basic with '6k±1' prime checker(v2)
+// basic with '6k±1' prime checker(v2), only the candidates 6k-1 and 6k+1 are checked after 2 and 3
 size_t prim_V2(size_t n, uint64_t prims[n]){
 
-    if(n == 0){
-        return 0;
-    }
-    else{
-        prims[0] = 2;
-    
-        if(n == 1) { return 1;}
+    static const uint64_t first[] = {2, 3};
+    size_t count = (n < 2) ? n : 2;
+    memcpy(prims, first, count * sizeof(uint64_t));
 
-        else if(n == 2) {prims[1] = 3;}
-
-        // n > 2
-        else{
-            prims[1] = 3;
-            uint64_t num = 5;
-            int index = 2;
-            size_t count = 2;
-           
-            while(count < n){
-
-                if(num == UINT64_MAX){
-                    return n;
-                }
-
-                if(checkPrime_V2(num)){
-                    count++;
-                    prims[index++] = num;
-                }
-                num++;
-            }
+    // the steps alternate between 2 (6k-1 -> 6k+1) and 4 (6k+1 -> 6k+5), UINT64_MAX = 6k+3 is never reached
+    uint64_t step = 2;
+    for(uint64_t num = 5 ; count < n && num < UINT64_MAX - 4 ; num += step, step ^= 6){
+        if(checkPrime_V2(num)){
+            prims[count++] = num;
         }
     }
-    return n;
+    return count;
 }
 
-// basic with mrp test
-size_t prim_V3(size_t n, uint64_t prims[n]){
-
-    if(n == 0){
-        return 0;
+// deterministic base sets of the Miller-Rabin test, a set is enough for every number below its limit.
+// source : https://en.wikipedia.org/wiki/Miller%E2%80%93Rabin_primality_test
+static const struct {
+    uint64_t limit;
+    size_t count;
+    uint64_t bases[12];
+} baseSets[] = {
+    {2047ULL,                   1, {2}},
+    {1373653ULL,                2, {2, 3}},
+    {9080191ULL,                2, {31, 73}},
+    {25326001ULL,               3, {2, 3, 5}},
+    {3215031751ULL,             4, {2, 3, 5, 7}},
+    {4759123141ULL,             3, {2, 7, 61}},
+    {1122004669633ULL,          4, {2, 13, 23, 1662803}},
+    {2152302898747ULL,          5, {2, 3, 5, 7, 11}},
+    {3474749660383ULL,          6, {2, 3, 5, 7, 11, 13}},
+    {341550071728321ULL,        7, {2, 3, 5, 7, 11, 13, 17}},
+    // the 7 bases of Jim Sinclair (as in checkPrime_V4) are fewer than the 9 and 12 prime bases above this
+    {UINT64_MAX,                7, {2, 325, 9375, 28178, 450775, 9780504, 1795265022}},
+};
+
+// Miller-Rabin test of an odd n with the base set of index set
+static bool millerRabin(uint64_t n, size_t set){
+
+    montgomery_t m;
+    montgomeryInit(&m, n);
+    for(size_t i = 0 ; i < baseSets[set].count ; i++){
+        if(!strongProbablePrime(&m, baseSets[set].bases[i])){
+            return false;
+        }
     }
-    else{
-        prims[0] = 2;
-    
-        if(n == 1) { return 1;}
-
-        else if(n == 2) {prims[1] = 3;}
-
-        // n > 2
-        else{
-            prims[1] = 3;
-            uint64_t num = 5;
-            int index = 2;
-            size_t count = 2;
-
-            // selecting a respectively
-            // source : https://en.wikipedia.org/wiki/Miller%E2%80%93Rabin_primality_test
-            // prim <= 2047
-            if(n < 310){
-                 while(count < n){
+    return true;
+}
 
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
+// the 48 residues modulo 210 = 2*3*5*7 that are coprime to 210, every prime above 7 is one of them modulo 210
+static const uint16_t wheel[48] = {
+    1, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67,
+    71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 121, 127, 131, 137, 139,
+    143, 149, 151, 157, 163, 167, 169, 173, 179, 181, 187, 191, 193, 197, 199, 209,
+};
 
-                    if(checkPrime_V3(num,2)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
-            }
-            // prim <= 1373653
-            else if(n < 105223){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
+#define WHEEL           210
+#define WHEEL_BLOCK     (WHEEL * 128)
+// the odd primes below this limit are crossed off in the presieve, so a survivor below its square is prime
+#define PRESIEVE_LIMIT  256
 
-            }// prim <= 9080191
-            else if (n < 607417){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,31) && checkPrime_V3(num,73)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
-            }// prim <= 25326001
-            else if (n < 1585371){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3) && checkPrime_V3(num,5)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
+// basic with mrp test. The candidates come from the mod 210 wheel, a block of them is presieved by the primes
+// from 11 to 251 first and only the survivors are tested with the smallest deterministic base set for their size.
+size_t prim_V3(size_t n, uint64_t prims[n]){
 
-            }else if (approximate(n) - 10000 < 3215031751){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)
-                     && checkPrime_V3(num,5) && checkPrime_V3(num,7)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
+    static const uint64_t first[] = {2, 3, 5, 7};
+    size_t count = (n < 4) ? n : 4;
+    memcpy(prims, first, count * sizeof(uint64_t));
+    if(count == n){
+        return count;
+    }
 
-            }else if (approximate(n) - 10000<  4759123141){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,7)
-                     && checkPrime_V3(num,61)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }  
-            }else if (approximate(n) - 10000 < 1122004669633){
-                while(count < n){
-                        if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,13)
-                     && checkPrime_V3(num,23) && checkPrime_V3(num,1662803)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
+    pthread_once(&divisorsOnce, buildDivisors);
+    bool composite[WHEEL_BLOCK];
+    size_t set = 0;
 
-            }else if (approximate(n) - 10000 < 2152302898747){
-                 while(count < n){
-                        if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)
-                     && checkPrime_V3(num,5) && checkPrime_V3(num,7)
-                     && checkPrime_V3(num,11)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
-            }else if(approximate(n) - 10000 < 3474749660383){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)
-                     && checkPrime_V3(num,5) && checkPrime_V3(num,7)
-                     && checkPrime_V3(num,11) && checkPrime_V3(num,13)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
+    for(uint64_t base = 0 ; count < n && base <= UINT64_MAX - WHEEL_BLOCK ; base += WHEEL_BLOCK){
 
-            }else if(approximate(n) - 10000 < 341550071728321){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)
-                     && checkPrime_V3(num,5) && checkPrime_V3(num,7)
-                     && checkPrime_V3(num,11) && checkPrime_V3(num,13)
-                     && checkPrime_V3(num,17)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
-                }
+        // 3, 5 and 7 are left out by the wheel, the presieve starts with 11 (index 3 of the divisor table).
+        // Only odd multiples are crossed off, from the square of p on, so the presieving primes survive themselves.
+        memset(composite, false, sizeof(composite));
+        for(size_t i = 3 ; divisors[i].prime < PRESIEVE_LIMIT ; i++){
+            uint64_t p = divisors[i].prime;
+            uint64_t start = (base + p - 1) / p * p;
+            if(start < p * p){
+                start = p * p;
+            }
+            if(start % 2 == 0){
+                start += p;
+            }
+            for(uint64_t j = start - base ; j < WHEEL_BLOCK ; j += 2 * p){
+                composite[j] = true;
+            }
+        }
 
-            }else if(approximate(n) - 10000 < 3825123056546413051){
-                while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
-                    }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)
-                     && checkPrime_V3(num,5) && checkPrime_V3(num,7)
-                     && checkPrime_V3(num,11) && checkPrime_V3(num,13)
-                     && checkPrime_V3(num,17)  && checkPrime_V3(num,19)
-                     && checkPrime_V3(num,23)){
-                        count++;
-                        prims[index++] = num;
-                    }
-                num++;
+        for(size_t k = 0 ; k < WHEEL_BLOCK && count < n ; k += WHEEL){
+            for(size_t r = 0 ; r < 48 && count < n ; r++){
+                size_t offset = k + wheel[r];
+                uint64_t num = base + offset;
+                // 1 is the first residue of the wheel, but no prime
+                if(composite[offset] || num == 1){
+                    continue;
                 }
-
-            }else if (approximate(n) - 10000 < UINT64_MAX){
-                 while(count < n){
-                    if(num == UINT64_MAX){
-                        return n;
+                if(num >= PRESIEVE_LIMIT * PRESIEVE_LIMIT){
+                    // the candidates grow, so the base set only moves forward
+                    while(num >= baseSets[set].limit){
+                        set++;
                     }
-                    if(checkPrime_V3(num,2) && checkPrime_V3(num,3)
-                     && checkPrime_V3(num,5) && checkPrime_V3(num,7)
-                     && checkPrime_V3(num,11) && checkPrime_V3(num,13)
-                     && checkPrime_V3(num,17)  && checkPrime_V3(num,19)
-                     && checkPrime_V3(num,23) && checkPrime_V3(num,29)
-                    && checkPrime_V3(num,31) && checkPrime_V3(num,37)){
-                        count++;
-                        prims[index++] = num;
+                    if(!millerRabin(num, set)){
+                        continue;
                     }
-                num++;
                 }
+                prims[count++] = num;
             }
         }
     }
-    return n;
+    return count;
 }
 
-// Sieve of Eratosthenes with calloc optimization + checking evens only by using 2 + approximation used.
-size_t prim_V4(size_t n, uint64_t prims[n]) {
-
-    if(n == 0){
-        return 0;
-    }
-
-    // until that number, every number must be checked. 
-    uint64_t untill = approximate(n);
-
-    // we use calloc instead of malloc + memset because of performance reasons. Therefore false means number is prime
-    // and true means number is not prime.
-    bool* boolArr = (bool*)calloc((untill+1),sizeof(bool));
+// odd numbers of one window of nearPrime()
+#define NEAR_WINDOW     128
+// a window is presieved by the odd primes below this limit
+#define NEAR_PRESIEVE   128
+
+// prime next to x: the smallest prime > x if up is set, the largest prime < x otherwise. The odd numbers next to x
+// are sieved in windows by the primes of the divisor table and only the survivors are tested with Miller-Rabin,
+// the gaps below 2^64 are short enough that the first window almost always contains the result.
+// For up x must be below the largest 64 bit prime, for down it must be above 2.
+uint64_t nearPrime(uint64_t x, bool up){
+
+    if(up && x < 2){
+        return 2;
+    }
+    if(!up && x <= 3){
+        return 2;
+    }
+    pthread_once(&divisorsOnce, buildDivisors);
+
+    // the window holds start, start +- 2, start +- 4, ...
+    uint64_t start = up ? (x + 1) | 1 : (x - 2) | 1;
+    size_t set = 0;
+    while(true){
+        // the window ends at UINT64_MAX or 3, the result is always found before that
+        uint64_t room = up ? (UINT64_MAX - start) / 2 + 1 : (start - 3) / 2 + 1;
+        size_t width = (room < NEAR_WINDOW) ? (size_t)room : NEAR_WINDOW;
+        bool composite[NEAR_WINDOW] = {false};
+
+        // start +- 2k is a multiple of p for k = (-+start) / 2 mod p, the prime p itself is kept
+        for(size_t i = 0 ; divisors[i].prime < NEAR_PRESIEVE ; i++){
+            uint64_t p = divisors[i].prime;
+            uint64_t r = start % p;
+            uint64_t k = (up ? (p - r) % p : r) * ((p + 1) / 2) % p;
+            for( ; k < width ; k += p){
+                composite[k] = (up ? start + 2 * k : start - 2 * k) != p;
+            }
+        }
 
-    if(boolArr == NULL){
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
-    }
-
-    // start the loop with 2, but loop with 2 is not included with the main loop, because
-    // all the even numbers are eliminated by that, so there is no need to look for 4, 6, 8, 10, etc.
-    // after that main loop for the elimination of non-prime numbers will start with 3 and always
-    // will be incremented by 2 to avoid all of the even numbers.
-    size_t i = 2;
-    if (boolArr[i] == false) {
-    for (size_t j = i * i; j <= untill; j += i) {
-        boolArr[j] = true;
-        } 
+        for(size_t k = 0 ; k < width ; k++){
+            uint64_t num = up ? start + 2 * k : start - 2 * k;
+            if(composite[k]){
+                continue;
+            }
+            if(num < NEAR_PRESIEVE * NEAR_PRESIEVE){
+                return num;
+            }
+            while(num >= baseSets[set].limit){
+                set++;
+            }
+            while(set > 0 && num < baseSets[set - 1].limit){
+                set--;
+            }
+            if(millerRabin(num, set)){
+                return num;
+            }
+        }
+        start = up ? start + 2 * width : start - 2 * width;
     }
+}
 
-    // main loop for only odd numbers, because even numbers are eliminated.
-    for (size_t i = 3; i * i <= untill; i+=2) { 
-        if (boolArr[i] == false) {
-            for (size_t j = i * i; j <= untill; j += i) {
-                boolArr[j] = true;
-            } 
+// The sieve of Versions 4 and 5 is one array until approximate(n), but it is split into blocks of SIEVE_BLOCK
+// numbers that fit into the L2 cache. In the first phase the threads take the blocks one after the other: a block
+// is initialised, crossed off by the sieving primes until the square root of its end and its primes are counted.
+// The prefix sums of the counts are the positions of the first prime of every block in prims[], so in the second
+// phase the threads extract the blocks into prims[] concurrently and the first n primes are cut off exactly.
+#define SIEVE_BLOCK         262144
+#define MAX_SIEVE_THREADS   64
+// smaller sieves are done by the calling thread alone, starting threads would take longer than the sieve
+#define MIN_PARALLEL_BLOCKS 8
+
+typedef struct {
+    bool* arr;
+    uint64_t untill;
+    size_t blocks;
+    size_t next;                // next block to take, taken by an atomic increment
+    bool prime;                 // value of arr[] that marks a prime
+    const uint32_t* primes;     // odd sieving primes until sqrt(untill)
+    size_t primeCount;
+    size_t* counts;             // primes per block, exclusive prefix sums after the first phase
+    uint64_t* prims;
+    size_t n;
+} block_sieve_t;
+
+static void* sieveBlocks(void* arg){
+
+    block_sieve_t* s = (block_sieve_t*)arg;
+    size_t b;
+    while((b = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED)) < s->blocks){
+        uint64_t low = b * SIEVE_BLOCK;
+        uint64_t high = (s->untill - low < SIEVE_BLOCK) ? s->untill : low + SIEVE_BLOCK - 1;
+        bool* arr = s->arr;
+
+        if(s->prime){
+            // Version 5: odd numbers are marked as prime and even numbers as not prime by SIMD, 16 numbers at a
+            // time. low is even, so the pattern starts with an even number in every block.
+            const __m128i odd = _mm_set1_epi16(0x0100);
+            uint64_t i = low;
+            for( ; i + 15 <= high ; i += 16){
+                _mm_storeu_si128((__m128i*)(arr + i), odd);
+            }
+            for( ; i <= high ; i++){
+                arr[i] = (i & 1);
+            }
+        }else{
+            // Version 4: the array is zeroed by calloc, so every number starts as prime and the multiples of 2 are
+            // crossed off like the multiples of every other prime
+            for(uint64_t j = (low < 4) ? 4 : low ; j <= high ; j += 2){
+                arr[j] = true;
+            }
+        }
+        if(low == 0){
+            arr[2] = s->prime;
         }
-    }
 
-    
-    size_t index = 0; // create an index to iterate over prims[];
-    // correctly place the prime numbers to the prims[]
-    // start from the second index because 0 and 1 are not prime so there is no need to check these indexes. 
-    for (uint64_t i = 2; i <= untill; i++) {
-        if (boolArr[i] == false) {
-            prims[index] = i;
-            if (index == n) {
+        // main loop for only odd numbers, because even numbers are eliminated.
+        for(size_t i = 0 ; i < s->primeCount ; i++){
+            uint64_t p = s->primes[i];
+            if(p * p > high){
                 break;
             }
-            index++;
+            uint64_t start = (low + p - 1) / p * p;
+            if(start < p * p){
+                start = p * p;
+            }
+            if((start & 1) == 0){
+                start += p;
+            }
+            for(uint64_t j = start ; j <= high ; j += 2 * p){
+                arr[j] = !s->prime;
+            }
+        }
+
+        // a single thread extracts the whole array in order afterwards and does not need the counts
+        if(s->counts != NULL){
+            size_t count = 0;
+            for(uint64_t i = (low < 2) ? 2 : low ; i <= high ; i++){
+                count += (arr[i] == s->prime);
+            }
+            s->counts[b] = count;
         }
     }
-    
-    return index;
+    return NULL;
 }
 
-// Sieve of Eratosthenes with SIMD + approx
-// almost the same algorithm, but the difference is here malloc is used,
-// because with SIMD instructions, the boolean pointer created is initialised.
-size_t prim_V5(size_t n, uint64_t prims[n]) {
+static void* extractBlocks(void* arg){
 
-    uint64_t untill = approximate(n);
+    block_sieve_t* s = (block_sieve_t*)arg;
+    size_t b;
+    while((b = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED)) < s->blocks){
+        // blocks behind the nth prime are not extracted at all
+        size_t index = s->counts[b];
+        if(index >= s->n){
+            continue;
+        }
+        uint64_t low = b * SIEVE_BLOCK;
+        uint64_t high = (s->untill - low < SIEVE_BLOCK) ? s->untill : low + SIEVE_BLOCK - 1;
+        for(uint64_t i = (low < 2) ? 2 : low ; i <= high && index < s->n ; i++){
+            if(s->arr[i] == s->prime){
+                s->prims[index++] = i;
+            }
+        }
+    }
+    return NULL;
+}
 
-    bool* boolArr = (bool*)malloc((untill+1) * sizeof(bool));
+// runs worker in threads threads, the calling thread included, until all blocks are taken
+static void runBlocks(void* (*worker)(void*), block_sieve_t* s, int threads){
 
-    if(boolArr == NULL){
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
+    pthread_t tids[MAX_SIEVE_THREADS];
+    int started = 0;
+    s->next = 0;
+    while(started + 1 < threads && started + 1 < MAX_SIEVE_THREADS && (size_t)started + 1 < s->blocks
+          && pthread_create(&tids[started], NULL, worker, s) == 0){
+        started++;
     }
-
-    // Helper will be copied to boolArr to initialise its boolean values. All of the even indexes are marked as false
-    // since they are even and not prime, all the odds are marked as true, which will be inside this method.
-    bool* helper = (bool*) malloc(16 * sizeof(bool));
-    if(helper == NULL){
-        fprintf(stderr,"Memory can not be allocated!\n");
-        exit(0);
+    worker(s);
+    for(int i = 0 ; i < started ; i++){
+        pthread_join(tids[i], NULL);
     }
-    *(helper+0)  = false;
-    *(helper+1)  = true;
-    *(helper+2)  = false;
-    *(helper+3)  = true;
-    *(helper+4)  = false;
-    *(helper+5)  = true;
-    *(helper+6)  = false;
-    *(helper+7)  = true;
-    *(helper+8)  = false;
-    *(helper+9)  = true;
-    *(helper+10) = false;
-    *(helper+11) = true;
-    *(helper+12) = false;
-    *(helper+13) = true;
-    *(helper+14) = false;
-    *(helper+15) = true;
+}
 
-    const __m128i* helper_vec  = (__m128i*)helper; // pointer to the memory location of the source array
-    __m128i* boolArr_vec = (__m128i*)boolArr; // pointer to the memory location of the destination array
+// Versions 4 and 5 on the given number of threads (0 := all online processors). Version 4 (simd == false) starts with a zeroed array from calloc
+// where false marks a prime, Version 5 initialises its blocks by SIMD and true marks a prime.
+// 0 is returned if memory can not be allocated, the caller decides how to report it.
+size_t sieveParallel(size_t n, uint64_t prims[n], int threads, bool simd){
 
-    // try to select all even numbers as not-prim except 2 by SIMD.
-    for (size_t i = 0; i < untill / 16; i+=1) {
-        boolArr_vec[i] = _mm_loadu_si128(helper_vec);
-    }
-    
-    size_t i = untill - (untill % 16);
-    while(i <= untill) {
-        if (i % 2 == 0) {
-            boolArr[i] = false;
-        } else {
-            boolArr[i] = true;
-        }
-        i++;
+    if(n == 0){
+        return 0;
     }
-    
-    
-    // 2 is prime, so these are fixed. 0 and 1 are not fixed because iteration will start with index 2 of the boolArr.
-    boolArr[2] = true;
 
-    // main loop for only odd numbers, because even numbers are eliminated.
-    for (size_t i = 3; i * i <= untill; i+=2) { 
-        if (boolArr[i] == true) {
-            for (size_t j = i * i; j < untill; j += i) {
-                boolArr[j] = false;
-            } 
-        }
+    // until that number, every number must be checked.
+    block_sieve_t s;
+    memset(&s, 0, sizeof(s));
+    s.untill = approximate(n);
+    s.blocks = s.untill / SIEVE_BLOCK + 1;
+    s.prime = simd;
+    s.prims = prims;
+    s.n = n;
+
+    if(s.blocks < MIN_PARALLEL_BLOCKS){
+        threads = 1;
+    }else if(threads == 0){
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    // we use calloc instead of malloc + memset in Version 4 because of performance reasons. Large sieves are zeroed
+    // huge pages that are faulted in by the threads before the sieving starts.
+    s.arr = (bool*)allocateLarge(s.untill + 1, !simd, threads);
+    s.counts = (threads > 1) ? (size_t*)malloc(s.blocks * sizeof(size_t)) : NULL;
+    uint32_t* primes = NULL;
+    s.primeCount = sievingPrimes(isqrt(s.untill), &primes);
+    s.primes = primes;
+    if(s.arr == NULL || (threads > 1 && s.counts == NULL) || s.primeCount == SIZE_MAX){
+        freeLarge(s.arr);
+        free(s.counts);
+        free(primes);
+        return 0;
     }
 
-    size_t index = 0; // create an index to iterate over prims[];
+    runBlocks(sieveBlocks, &s, threads);
 
-    //correctly place the prime numbers to the prims[] 
-    for (size_t i = 2; i <= untill; i++) {
-        if (boolArr[i] == true) {
-            prims[index++] = i;
+    size_t total = 0;
+    if(threads > 1){
+        for(size_t b = 0 ; b < s.blocks ; b++){
+            size_t count = s.counts[b];
+            s.counts[b] = total;
+            total += count;
         }
-        if (index == n) {
-            return index;
+        runBlocks(extractBlocks, &s, threads);
+    }else{
+        //correctly place the prime numbers to the prims[]
+        for(uint64_t i = 2 ; i <= s.untill && total < n ; i++){
+            if(s.arr[i] == s.prime){
+                prims[total++] = i;
+            }
         }
     }
-    
-    return index;
+
+    freeLarge(s.arr);
+    free(s.counts);
+    free(primes);
+    return (total < n) ? total : n;
+}
+
+// Sieve of Eratosthenes with calloc optimization + checking evens only by using 2 + approximation used.
+// The blocks of the sieve are sieved and extracted by all online processors.
+size_t prim_V4(size_t n, uint64_t prims[n]) {
+    return sieveParallel(n, prims, 0, false);
+}
+
+// Sieve of Eratosthenes with SIMD + approx
+// almost the same algorithm, but the difference is here malloc is used,
+// because with SIMD instructions, the boolean pointer created is initialised.
+size_t prim_V5(size_t n, uint64_t prims[n]) {
+    return sieveParallel(n, prims, 0, true);
 }
 
 // sieve of atkin 
@@ -836,20 +915,33 @@ size_t prim_V6(size_t n, uint64_t prims[n]){
         return 0;
     }
     else{
-        SieveOfAtkin(n,prims,approximate(n));
+        if(!SieveOfAtkin(n,prims,approximate(n))){
+            return 0;
+        }
     }
     return n;
 }
 
 
+// copies from STREAM_COPY bytes on bypass the caches with non-temporal stores. prims[] of a large n is written
+// once and not read back soon, so ordinary stores would only evict the working set of the caller for it.
+#define STREAM_COPY     (8UL << 20)
+
 // a table which can have the size of total prime numbers from 2 to 2^64 must be created before using this method.
-// this method uses the primeNumbersTable and SISD instructions to load uint64_t prime numbers to the prims[].
-size_t prim_V7(size_t n, uint64_t prims[n]) {
+// this method uses the given table and SISD instructions to load uint64_t prime numbers to the prims[].
+size_t prim_V7(const uint64_t table[], size_t n, uint64_t prims[n]) {
 
     if(n == 0){
         return 0;
     }
 
+    if(n * sizeof(uint64_t) >= STREAM_COPY){
+        for (size_t i = 0; i < n; i++) {
+            _mm_stream_si64((long long*)&prims[i], (long long)table[i]);
+        }
+        _mm_sfence();
+        return n;
+    }
     for (size_t i = 0; i < n; i++) {
         prims[i] = table[i];
     }
@@ -857,8 +949,8 @@ size_t prim_V7(size_t n, uint64_t prims[n]) {
 }
 
 // a table which can have the size of total prime numbers from 2 to 2^64 must be created before using this method.
-// uses the table to find first N prime numbers, while using SIMD instructions for optimization.
-size_t prim_V8(size_t n, uint64_t prims[n]) {
+// uses the given table to find first N prime numbers, while using SIMD instructions for optimization.
+size_t prim_V8(const uint64_t table[], size_t n, uint64_t prims[n]) {
     
     if(n == 0){
         return 0;
@@ -875,11 +967,20 @@ size_t prim_V8(size_t n, uint64_t prims[n]) {
         size--;
     }
     
-    __m128i* table_vec = (__m128i*)table; // pointer to the memory location of the source array
+    // streaming stores need an aligned destination, prims[] of allocateLarge() and mapped files already is
+    size_t start = 0;
+    if(n * sizeof(uint64_t) >= STREAM_COPY && ((uintptr_t)prims & 15) == 0){
+        for( ; start + 1 < size ; start += 2){
+            _mm_stream_si128((__m128i*)&prims[start], _mm_loadu_si128((const __m128i*)&table[start]));
+        }
+        _mm_sfence();
+    }
+
+    const __m128i* table_vec = (const __m128i*)table; // pointer to the memory location of the source array
     __m128i* prims_vec = (__m128i*)prims; // pointer to the memory location of the destination array
     
-    for(size_t i = 0 ; i < size/2 ; i++){
-        prims_vec[i] = _mm_loadu_si128(&table_vec[i]);
+    for(size_t i = start/2 ; i < size/2 ; i++){
+        _mm_storeu_si128(&prims_vec[i], _mm_loadu_si128(&table_vec[i]));
     }
     
     return n;
@@ -0,0 +1,404 @@
+#include "config.h"
+#include <sys/mman.h>
+
+// Context of libprimegen. Everything a call needs is either read from the context or allocated by the call
+// itself, so a context that is filled once can be shared between any number of threads.
+
+int primegen_init(primegen_ctx* ctx, const primegen_tuning* tuning){
+
+    if(ctx == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    memset(ctx, 0, sizeof(primegen_ctx));
+    if(tuning != NULL){
+        ctx->tuning = *tuning;
+    }
+
+    // defaults for every field that is not given
+    if(ctx->tuning.sieveLimit == 0){
+        ctx->tuning.sieveLimit = DEFAULT_SIEVE_LIMIT;
+    }
+    if(ctx->tuning.segmentSize == 0){
+        ctx->tuning.segmentSize = DEFAULT_SEGMENT_SIZE;
+    }
+    if(ctx->tuning.threads <= 0){
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        ctx->tuning.threads = (online < 1) ? 1 : (int)online;
+    }
+
+    // segments are aligned to the segment size, it must be a power of 2 so the last segment ends at UINT64_MAX
+    size_t segmentSize = ctx->tuning.segmentSize;
+    if((segmentSize & (segmentSize - 1)) != 0){
+        return PRIMEGEN_EINVAL;
+    }
+
+    size_t count = sievingPrimes(isqrt(ctx->tuning.sieveLimit), &ctx->sievingPrimes);
+    if(count == SIZE_MAX){
+        return PRIMEGEN_ENOMEM;
+    }
+    ctx->sievingCount = count;
+
+    if(ctx->tuning.cacheBytes != 0){
+        ctx->cache = createCache(ctx->tuning.cacheBytes, segmentSize);
+        if(ctx->cache == NULL){
+            free(ctx->sievingPrimes);
+            ctx->sievingPrimes = NULL;
+            return PRIMEGEN_ENOMEM;
+        }
+    }
+    return PRIMEGEN_OK;
+}
+
+// the table is either private, a mapping of a shared memory object or lazily filled
+void releaseTable(primegen_ctx* ctx){
+
+    if(ctx->tableMapping != NULL){
+        munmap(ctx->tableMapping, ctx->tableMappingSize);
+    }else{
+        freeLarge(ctx->table);
+    }
+    ctx->table = NULL;
+    ctx->tableSize = 0;
+    ctx->tableMapping = NULL;
+    ctx->tableMappingSize = 0;
+    releaseLazyTable(ctx->lazy);
+    ctx->lazy = NULL;
+}
+
+void primegen_destroy(primegen_ctx* ctx){
+
+    if(ctx == NULL){
+        return;
+    }
+    releaseTable(ctx);
+    destroyCache(ctx->cache);
+    free(ctx->sievingPrimes);
+    memset(ctx, 0, sizeof(primegen_ctx));
+}
+
+int primegen_create_table(primegen_ctx* ctx, size_t n){
+
+    if(ctx == NULL || n == 0){
+        return PRIMEGEN_EINVAL;
+    }
+
+    size_t total;
+    uint64_t* table = createTable(n, &total);
+    if(table == NULL){
+        return PRIMEGEN_ENOMEM;
+    }
+    releaseTable(ctx);
+    ctx->table = table;
+    ctx->tableSize = total;
+    return (total < n) ? PRIMEGEN_ERANGE : PRIMEGEN_OK;
+}
+
+int primegen_create_lazy_table(primegen_ctx* ctx, size_t n){
+
+    if(ctx == NULL || n == 0){
+        return PRIMEGEN_EINVAL;
+    }
+    primegen_lazy_table* lazy = createLazyTable(n);
+    if(lazy == NULL){
+        return PRIMEGEN_ENOMEM;
+    }
+    releaseTable(ctx);
+    ctx->lazy = lazy;
+    return PRIMEGEN_OK;
+}
+
+// primes of the table that are there without sieving: the whole table, or the filled part of the lazy table
+size_t readyTable(const primegen_ctx* ctx, const uint64_t** table){
+
+    if(ctx->lazy != NULL){
+        return lazyReady(ctx->lazy, table);
+    }
+    *table = ctx->table;
+    return ctx->tableSize;
+}
+
+int primegen_view_table(const primegen_ctx* ctx, size_t n, primegen_view* view){
+
+    if(ctx == NULL || view == NULL || n == 0){
+        return PRIMEGEN_EINVAL;
+    }
+    memset(view, 0, sizeof(primegen_view));
+    if(ctx->lazy != NULL){
+        int status = fillLazyTable(ctx, ctx->lazy, n, &view->primes);
+        if(status != PRIMEGEN_OK){
+            return status;
+        }
+        retainLazyTable(ctx->lazy);
+        view->lazy = ctx->lazy;
+    }else if(ctx->table != NULL && n <= ctx->tableSize){
+        view->primes = ctx->table;
+    }else{
+        return PRIMEGEN_ERANGE;
+    }
+    view->count = n;
+    return PRIMEGEN_OK;
+}
+
+void primegen_release_view(primegen_view* view){
+
+    if(view == NULL){
+        return;
+    }
+    releaseLazyTable(view->lazy);
+    memset(view, 0, sizeof(primegen_view));
+}
+
+size_t primegen_first(const primegen_ctx* ctx, size_t n, uint64_t prims[]){
+
+    if(ctx == NULL || n == 0){
+        return 0;
+    }
+    if(ctx->table != NULL && n <= ctx->tableSize){
+        return prim_V8(ctx->table, n, prims);
+    }
+    const uint64_t* table;
+    if(ctx->lazy != NULL && fillLazyTable(ctx, ctx->lazy, n, &table) == PRIMEGEN_OK){
+        return prim_V8(table, n, prims);
+    }
+
+    switch(planVersion(n, ctx->tuning.threads, ctx->tuning.memoryBudget)){
+        case 0: return prim(n, prims);
+        case 1: return prim_V1(n, prims);
+        case 2: return prim_V2(n, prims);
+        case 3: return prim_V3(n, prims);
+        case 4: return sieveParallel(n, prims, ctx->tuning.threads, false);
+        case 5: return sieveParallel(n, prims, ctx->tuning.threads, true);
+        case 6: return prim_V6(n, prims);
+        default: return 0;
+    }
+}
+
+int primegen_range(const primegen_ctx* ctx, uint64_t low, uint64_t high, primegen_segment_fn f, void* arg){
+
+    if(ctx == NULL || f == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    return sieveRange(ctx, low, high, f, arg);
+}
+
+static bool countSegment(const primegen_segment* seg, void* arg){
+
+    uint64_t* count = (uint64_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        *count += seg->arr[i];
+    }
+    return true;
+}
+
+int primegen_count(const primegen_ctx* ctx, uint64_t low, uint64_t high, uint64_t* count){
+
+    if(ctx == NULL || count == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    *count = 0;
+    return sieveRange(ctx, low, high, countSegment, count);
+}
+
+bool primegen_is_prime(uint64_t n){
+    return checkPrime_V4(n);
+}
+
+int primegen_pi(const primegen_ctx* ctx, uint64_t x, uint64_t* count){
+
+    if(ctx == NULL || count == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+
+    // the lazy table is filled until x first, sieving the range after it would cost as much
+    const uint64_t* table;
+    if(ctx->lazy != NULL){
+        int status = fillLazyTableTo(ctx, ctx->lazy, x, &table);
+        if(status != PRIMEGEN_OK && status != PRIMEGEN_ERANGE){
+            return status;
+        }
+    }
+
+    // inside the table the count is the index of the first prime greater than x
+    size_t tableSize = readyTable(ctx, &table);
+    if(tableSize != 0 && x < table[tableSize - 1]){
+        size_t lo = 0;
+        size_t hi = tableSize - 1;
+        while(lo < hi){
+            size_t mid = lo + (hi - lo) / 2;
+            if(table[mid] <= x){
+                lo = mid + 1;
+            }else{
+                hi = mid;
+            }
+        }
+        *count = lo;
+        return PRIMEGEN_OK;
+    }
+
+    // above the table only the part after its last prime is sieved
+    uint64_t low = 0;
+    uint64_t before = 0;
+    if(tableSize != 0){
+        low = table[tableSize - 1] + 1;
+        before = tableSize;
+    }
+    int status = primegen_count(ctx, low, x, count);
+    *count += before;
+    return status;
+}
+
+typedef struct {
+    uint64_t remaining;     // primes that are still to be skipped
+    uint64_t prime;         // the nth prime, once remaining reaches 0
+} nth_search_t;
+
+static bool nthSegment(const primegen_segment* seg, void* arg){
+
+    nth_search_t* search = (nth_search_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i] && --search->remaining == 0){
+            search->prime = seg->low + i;
+            return false;
+        }
+    }
+    return true;
+}
+
+int primegen_nth_prime(const primegen_ctx* ctx, uint64_t n, uint64_t* prime){
+
+    if(ctx == NULL || prime == NULL || n == 0){
+        return PRIMEGEN_EINVAL;
+    }
+    const uint64_t* table;
+    size_t tableSize = readyTable(ctx, &table);
+    if(n <= tableSize){
+        *prime = table[n - 1];
+        return PRIMEGEN_OK;
+    }
+    // the chunks of the lazy table until n are filled, which answers all later queries of them without sieving
+    if(ctx->lazy != NULL && fillLazyTable(ctx, ctx->lazy, n, &table) == PRIMEGEN_OK){
+        *prime = table[n - 1];
+        return PRIMEGEN_OK;
+    }
+
+    // the search continues after the table, the bound of approximate() ends the range
+    nth_search_t search = {n, 0};
+    uint64_t low = 0;
+    tableSize = readyTable(ctx, &table);
+    if(tableSize != 0){
+        low = table[tableSize - 1] + 1;
+        search.remaining -= tableSize;
+    }
+    uint64_t high = (n >= SIZE_MAX) ? UINT64_MAX : approximate((size_t)n);
+    int status = sieveRange(ctx, low, (high < low) ? UINT64_MAX : high, nthSegment, &search);
+    if(status != PRIMEGEN_OK){
+        return status;
+    }
+    if(search.remaining != 0){
+        return PRIMEGEN_ERANGE;
+    }
+    *prime = search.prime;
+    return PRIMEGEN_OK;
+}
+
+int primegen_next_prime(const primegen_ctx* ctx, uint64_t x, uint64_t* prime){
+
+    if(ctx == NULL || prime == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    if(x >= LARGEST_PRIME){
+        return PRIMEGEN_ERANGE;
+    }
+
+    // inside the table the prime follows the primes <= x
+    uint64_t count;
+    const uint64_t* table;
+    size_t tableSize = readyTable(ctx, &table);
+    if(tableSize != 0 && x < table[tableSize - 1] && primegen_pi(ctx, x, &count) == PRIMEGEN_OK){
+        *prime = table[count];
+        return PRIMEGEN_OK;
+    }
+    *prime = nearPrime(x, true);
+    return PRIMEGEN_OK;
+}
+
+int primegen_prev_prime(const primegen_ctx* ctx, uint64_t x, uint64_t* prime){
+
+    if(ctx == NULL || prime == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    if(x <= 2){
+        return PRIMEGEN_ERANGE;
+    }
+
+    // inside the table the prime is the last one of the primes <= x - 1
+    uint64_t count;
+    const uint64_t* table;
+    size_t tableSize = readyTable(ctx, &table);
+    if(tableSize != 0 && x - 1 < table[tableSize - 1] && primegen_pi(ctx, x - 1, &count) == PRIMEGEN_OK){
+        *prime = table[count - 1];
+        return PRIMEGEN_OK;
+    }
+    *prime = nearPrime(x, false);
+    return PRIMEGEN_OK;
+}
+
+int primegen_iterator_init(primegen_iterator* it, const primegen_ctx* ctx, uint64_t start){
+
+    if(it == NULL || ctx == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    memset(it, 0, sizeof(primegen_iterator));
+    it->ctx = ctx;
+    it->next = start;
+
+    // a segment holds at most one prime per odd number, plus 2
+    it->primes = (uint64_t*)malloc((ctx->tuning.segmentSize / 2 + 1) * sizeof(uint64_t));
+    return (it->primes == NULL) ? PRIMEGEN_ENOMEM : PRIMEGEN_OK;
+}
+
+static bool collectSegment(const primegen_segment* seg, void* arg){
+
+    primegen_iterator* it = (primegen_iterator*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            it->primes[it->count++] = seg->low + i;
+        }
+    }
+    return true;
+}
+
+int primegen_iterator_next(primegen_iterator* it, uint64_t* prime){
+
+    if(it == NULL || prime == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+
+    // the following segments are sieved until one of them contains a prime
+    while(it->pos == it->count){
+        if(it->end){
+            return PRIMEGEN_ERANGE;
+        }
+        uint64_t high = it->next | (it->ctx->tuning.segmentSize - 1);
+        it->count = 0;
+        it->pos = 0;
+        int status = sieveRange(it->ctx, it->next, high, collectSegment, it);
+        if(status != PRIMEGEN_OK){
+            return status;
+        }
+        it->end = (high == UINT64_MAX);
+        it->next = high + 1;
+    }
+
+    *prime = it->primes[it->pos++];
+    return PRIMEGEN_OK;
+}
+
+void primegen_iterator_destroy(primegen_iterator* it){
+
+    if(it == NULL){
+        return;
+    }
+    free(it->primes);
+    it->primes = NULL;
+}
@@ -0,0 +1,143 @@
+#include "config.h"
+
+// Sieve of the primes p == a (mod m) in [low, high]. A segment holds only the numbers of the progression,
+// arr[i] <=> first + i * m, so work and memory shrink by a factor of m compared to sieving every number of the range
+// and throwing the other residues away. A sieving prime p that does not divide m hits every p-th number of the
+// progression: first + i * m == 0 (mod p) for i == -first * m^-1 (mod p), so its index of the next multiple is kept
+// and advanced by p, exactly like a prime crosses off every p-th number of an ordinary segment. Primes dividing m
+// never divide a number of the progression if gcd(a, m) == 1 and are skipped. If gcd(a, m) > 1 every number of the
+// progression is a multiple of the gcd, so at most one of them is prime.
+
+// inverse of x modulo the prime p, x is not a multiple of p
+static uint64_t inverseMod(uint64_t x, uint64_t p){
+
+    int64_t t = 0, newT = 1;
+    int64_t r = (int64_t)p, newR = (int64_t)(x % p);
+    while(newR != 0){
+        int64_t q = r / newR;
+        int64_t tmp = t - q * newT;
+        t = newT;
+        newT = tmp;
+        tmp = r - q * newR;
+        r = newR;
+        newR = tmp;
+    }
+    return (uint64_t)((t < 0) ? t + (int64_t)p : t);
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b){
+    while(b != 0){
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// index of the first multiple of p in the progression first + i * m, p itself is not crossed off
+static uint64_t firstMultiple(uint64_t first, uint64_t m, uint64_t p){
+
+    uint64_t i = (p - first % p) % p * inverseMod(m, p) % p;
+    // 0 is only part of the progression for m == 1, it is no multiple that needs to be crossed off
+    if(first == 0 && i == 0){
+        i += p;
+    }
+    if(first <= p && (p - first) % m == 0 && i == (p - first) / m){
+        i += p;
+    }
+    return i;
+}
+
+int primegen_progression(const primegen_ctx* ctx, uint64_t a, uint64_t m, uint64_t low, uint64_t high,
+    primegen_progression_fn f, void* arg){
+
+    if(ctx == NULL || f == NULL || m == 0){
+        return PRIMEGEN_EINVAL;
+    }
+    uint64_t residue = a % m;
+    if(low > high){
+        return PRIMEGEN_OK;
+    }
+
+    // the only candidate of a progression whose numbers share a factor is that factor itself
+    if(gcd(residue, m) != 1){
+        uint64_t candidate = (residue == 0) ? m : residue;
+        bool arr[1] = {true};
+        primegen_progression_segment seg = {candidate, m, 1, arr};
+        if(candidate >= low && candidate <= high && gcd(residue, m) == candidate && checkPrime_V4(candidate)){
+            f(&seg, arg);
+        }
+        return PRIMEGEN_OK;
+    }
+
+    // first number of the progression in the range, the progression may not reach into it
+    uint64_t offset = (residue + m - low % m) % m;
+    if(offset > high - low){
+        return PRIMEGEN_OK;
+    }
+    uint64_t first = low + offset;
+    uint64_t last = (high - first) / m;     // index of the last number, the count may not fit into 64 bits
+
+    const uint32_t* primes = ctx->sievingPrimes;
+    size_t count = ctx->sievingCount;
+    uint32_t* own = NULL;
+    if(high > ctx->tuning.sieveLimit){
+        count = sievingPrimes(isqrt(high), &own);
+        if(count == SIZE_MAX){
+            return PRIMEGEN_ENOMEM;
+        }
+        primes = own;
+    }
+    // only the sieving primes until sqrt(high) are needed, 2 is not among them
+    uint64_t root = isqrt(high);
+    size_t used = 0;
+    while(used < count && primes[used] <= root){
+        used++;
+    }
+
+    size_t segmentSize = ctx->tuning.segmentSize;
+    bool* arr = (bool*)malloc(segmentSize);
+    uint64_t* next = (uint64_t*)malloc((used + 1) * sizeof(uint64_t));
+    if(arr == NULL || next == NULL){
+        free(arr);
+        free(next);
+        free(own);
+        return PRIMEGEN_ENOMEM;
+    }
+    // next[0] belongs to 2, which only matters for an odd m
+    next[0] = (m % 2 == 0 || root < 2) ? UINT64_MAX : firstMultiple(first, m, 2);
+    for(size_t k = 0 ; k < used ; k++){
+        next[k + 1] = (m % primes[k] == 0) ? UINT64_MAX : firstMultiple(first, m, primes[k]);
+    }
+
+    for(uint64_t start = 0 ; ; start += segmentSize){
+        size_t len = (last - start < segmentSize) ? (size_t)(last - start) + 1 : segmentSize;
+        memset(arr, true, len);
+        for(size_t k = 0 ; k <= used ; k++){
+            if(next[k] - start >= len){
+                continue;
+            }
+            size_t p = (k == 0) ? 2 : primes[k - 1];
+            size_t i = next[k] - start;
+            for( ; i < len ; i += p){
+                arr[i] = false;
+            }
+            // the index can only wrap around after the last segment, where it is not used anymore
+            next[k] = start + i;
+        }
+        // 0 and 1 are the only numbers that no prime crosses off
+        for(size_t i = 0 ; i < len && first + (start + i) * m < 2 ; i++){
+            arr[i] = false;
+        }
+
+        primegen_progression_segment seg = {first + start * m, m, len, arr};
+        if(!f(&seg, arg) || last - start < segmentSize){
+            break;
+        }
+    }
+
+    free(arr);
+    free(next);
+    free(own);
+    return PRIMEGEN_OK;
+}
@@ -0,0 +1,163 @@
+#include "config.h"
+
+// Uniform random primes of a range. A candidate is drawn uniformly from the odd numbers of [low, high] (and 2 if it
+// lies in the range) and kept if it is prime, otherwise it is rejected and the next one is drawn. Every prime is
+// exactly as likely as any other, all primes but 2 are odd and 2 is a candidate of its own, so rejection gives an
+// exactly uniform distribution without knowing how many primes the range holds.
+//
+// Candidates are drawn in batches. The batch is sorted and split into windows of one segment: a window with many
+// candidates is sieved once with the sieving primes of the context (the wheel of sieveSegment() presieves it),
+// survivors above the sieve limit are confirmed by Miller-Rabin. In a wide range like [2^40, 2^63] nearly every
+// candidate has a window of its own and a sieved segment would decide about a single number, so sparse candidates
+// are tested by checkPrime_V4() directly.
+//
+// The random numbers come from a counter: draw i is mixPrime(seed + i * golden ratio), so a sampler only keeps the
+// counter. Candidates of a batch that are not needed are given back by resetting the counter after the last
+// candidate used, so the same seed gives the same primes no matter how the samples are split into calls.
+
+#define SAMPLE_BATCH        65536       // most candidates per batch
+#define SAMPLE_DENSITY      1024        // a window is sieved if it holds a candidate per SAMPLE_DENSITY numbers
+
+typedef struct {
+    uint64_t value;
+    size_t index;       // position in the order of the draws
+} sample_draw_t;
+
+static int compareDraws(const void* a, const void* b){
+    uint64_t x = ((const sample_draw_t*)a)->value;
+    uint64_t y = ((const sample_draw_t*)b)->value;
+    return (x > y) - (x < y);
+}
+
+// next random number of the sampler, mixPrime() is the finalizer of splitmix64
+static uint64_t nextRandom(primegen_sampler* sampler){
+    return mixPrime(sampler->seed + sampler->counter++ * 0x9e3779b97f4a7c15ULL);
+}
+
+// uniform index in [0, n) by the multiply and shift of Lemire, the few biased products are rejected
+static uint64_t drawIndex(primegen_sampler* sampler, uint64_t n){
+
+    unsigned __int128 m = (unsigned __int128)nextRandom(sampler) * n;
+    if((uint64_t)m < n){
+        uint64_t threshold = (0 - n) % n;
+        while((uint64_t)m < threshold){
+            m = (unsigned __int128)nextRandom(sampler) * n;
+        }
+    }
+    return (uint64_t)(m >> 64);
+}
+
+// odd numbers <= x
+static uint64_t oddsUntil(uint64_t x){
+    return x / 2 + (x & 1);
+}
+
+int primegen_sampler_init(primegen_sampler* sampler, uint64_t low, uint64_t high, uint64_t seed){
+
+    if(sampler == NULL || low > high){
+        return PRIMEGEN_EINVAL;
+    }
+    sampler->low = low;
+    sampler->high = high;
+    sampler->seed = seed;
+    sampler->counter = 0;
+
+    // the odd candidates start at the first odd number of the range, 2 is the last candidate
+    sampler->first = low | 1;
+    sampler->two = (low <= 2 && high >= 2);
+    sampler->candidates = oddsUntil(high) - ((low == 0) ? 0 : oddsUntil(low - 1)) + sampler->two;
+
+    // a range without primes would reject candidates forever
+    if(!sampler->two && (low - 1 >= LARGEST_PRIME || nearPrime(low - 1, true) > high)){
+        return PRIMEGEN_ERANGE;
+    }
+    return PRIMEGEN_OK;
+}
+
+// decides about the sorted candidates [begin, end) of one window, prime[] is indexed by the order of the draws
+static void decideWindow(const primegen_ctx* ctx, const sample_draw_t* draws, size_t begin, size_t end, bool* arr, bool prime[]){
+
+    uint64_t low = draws[begin].value;
+    uint64_t high = draws[end - 1].value;
+    if((end - begin) * SAMPLE_DENSITY < high - low + 1){
+        for(size_t i = begin ; i < end ; i++){
+            prime[draws[i].index] = checkPrime_V4(draws[i].value);
+        }
+        return;
+    }
+
+    // above the sieve limit the sieving primes of the context only presieve the window
+    sieveSegment(low, high, arr, ctx->sievingPrimes, ctx->sievingCount);
+    bool exact = high <= ctx->tuning.sieveLimit;
+    for(size_t i = begin ; i < end ; i++){
+        uint64_t x = draws[i].value;
+        prime[draws[i].index] = arr[x - low] && (exact || checkPrime_V4(x));
+    }
+}
+
+int primegen_sample(const primegen_ctx* ctx, primegen_sampler* sampler, size_t count, uint64_t primes[]){
+
+    if(ctx == NULL || sampler == NULL || (primes == NULL && count != 0)){
+        return PRIMEGEN_EINVAL;
+    }
+
+    // about ln(high) / 2 odd candidates are drawn per prime, the batch is sized to end with the last sample
+    double expected = (sampler->high < 16) ? 2.0 : log((double)sampler->high) / 2.0 + 1.0;
+    size_t segmentSize = ctx->tuning.segmentSize;
+    sample_draw_t* draws = (sample_draw_t*)malloc(SAMPLE_BATCH * sizeof(sample_draw_t));
+    uint64_t* values = (uint64_t*)malloc(SAMPLE_BATCH * sizeof(uint64_t));
+    uint64_t* after = (uint64_t*)malloc(SAMPLE_BATCH * sizeof(uint64_t));
+    bool* prime = (bool*)malloc(SAMPLE_BATCH);
+    bool* arr = (bool*)malloc(segmentSize);
+    if(draws == NULL || values == NULL || after == NULL || prime == NULL || arr == NULL){
+        free(draws);
+        free(values);
+        free(after);
+        free(prime);
+        free(arr);
+        return PRIMEGEN_ENOMEM;
+    }
+
+    size_t found = 0;
+    while(found < count){
+        double wanted = (double)(count - found) * expected + 64.0;
+        size_t batch = (wanted < SAMPLE_BATCH) ? (size_t)wanted : SAMPLE_BATCH;
+
+        // the counter after every draw is kept, the sampler continues after the last candidate that is used
+        uint64_t odds = sampler->candidates - sampler->two;
+        for(size_t i = 0 ; i < batch ; i++){
+            uint64_t k = drawIndex(sampler, sampler->candidates);
+            values[i] = (k == odds) ? 2 : sampler->first + 2 * k;
+            draws[i].value = values[i];
+            draws[i].index = i;
+            after[i] = sampler->counter;
+        }
+        qsort(draws, batch, sizeof(sample_draw_t), compareDraws);
+
+        // windows are aligned to the segment size, so a window fits into arr
+        for(size_t begin = 0 ; begin < batch ; ){
+            uint64_t window = draws[begin].value / segmentSize;
+            size_t end = begin + 1;
+            while(end < batch && draws[end].value / segmentSize == window){
+                end++;
+            }
+            decideWindow(ctx, draws, begin, end, arr, prime);
+            begin = end;
+        }
+
+        // the primes are taken in the order they were drawn
+        for(size_t i = 0 ; i < batch && found < count ; i++){
+            sampler->counter = after[i];
+            if(prime[i]){
+                primes[found++] = values[i];
+            }
+        }
+    }
+
+    free(draws);
+    free(values);
+    free(after);
+    free(prime);
+    free(arr);
+    return PRIMEGEN_OK;
+}
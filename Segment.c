@@ -0,0 +1,248 @@
+#include "config.h"
+
+// Segmented Sieve of Eratosthenes over an arbitrary range [low, high]. Unlike prim(), which always starts at 2 and
+// writes every prime into prims[], the range sieve hands each sieved segment to a callback and only ever holds one
+// segment in memory. Segments are aligned to multiples of the segment size of the context, so every number belongs
+// to exactly one segment index. The segment size is a power of 2, therefore the last segment ends exactly at
+// UINT64_MAX and the segment bounds can never overflow. The context is only read, every call allocates its own
+// segment, so concurrent calls do not need any locking.
+
+// integer square root, floor(sqrt(n)). The floating point result is corrected because doubles can not represent
+// all 64 bit numbers.
+uint64_t isqrt(uint64_t n){
+
+    uint64_t r = sqrt((double)n);
+    // 4294967295 = floor(sqrt(UINT64_MAX)), r * r must not overflow while correcting
+    if(r > 4294967295){
+        r = 4294967295;
+    }
+    while(r * r > n){
+        r--;
+    }
+    while(r < 4294967295 && (r + 1) * (r + 1) <= n){
+        r++;
+    }
+    return r;
+}
+
+// gaps between the numbers coprime to 30 = 2*3*5: 1, 7, 11, 13, 17, 19, 23, 29, 31
+static const uint8_t wheelGaps[8] = {6, 4, 2, 4, 2, 4, 6, 2};
+// for r = 0..29 the index of the first number coprime to 30 that is >= r and how far away it is
+static const uint8_t wheelIndex[30] = {0, 0, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7};
+static const uint8_t wheelDistance[30] = {1, 0, 5, 4, 3, 2, 1, 0, 3, 2, 1, 0, 1, 0, 3, 2, 1, 0, 1, 0, 3, 2, 1, 0, 5, 4, 3, 2, 1, 0};
+
+// crosses off the multiples p * k with k coprime to 30 from arr[offset] on, offset is the multiple whose k has the
+// wheel index w. The other multiples are divisible by 2, 3 or 5 and never candidates. One turn of the wheel covers
+// 30 * p numbers and holds 8 multiples, all of them are written in one iteration with their offsets in registers,
+// only the last incomplete turn is written one by one.
+static void crossWheel(bool* arr, uint64_t len, uint64_t offset, uint64_t p, int w){
+
+    uint64_t o[8];
+    o[0] = 0;
+    for(int i = 1 ; i < 8 ; i++){
+        o[i] = o[i - 1] + wheelGaps[(w + i - 1) & 7] * p;
+    }
+    const uint64_t o1 = o[1], o2 = o[2], o3 = o[3], o4 = o[4], o5 = o[5], o6 = o[6], o7 = o[7];
+    const uint64_t turn = 30 * p;
+
+    uint64_t j = offset;
+    for( ; j + o7 < len ; j += turn){
+        arr[j] = false;
+        arr[j + o1] = false;
+        arr[j + o2] = false;
+        arr[j + o3] = false;
+        arr[j + o4] = false;
+        arr[j + o5] = false;
+        arr[j + o6] = false;
+        arr[j + o7] = false;
+    }
+    for(int i = 0 ; i < 8 && j + o[i] < len ; i++){
+        arr[j + o[i]] = false;
+    }
+}
+
+// sieves [low, high] into arr, arr[i] == true <=> low + i is prime. arr must hold high - low + 1 elements and
+// primes[] must contain all odd primes until sqrt(high).
+void sieveSegment(uint64_t low, uint64_t high, bool* arr, const uint32_t* primes, size_t count){
+
+    size_t len = high - low + 1;
+
+    // numbers coprime to 30 are candidates, the multiples of 2, 3 and 5 repeat every 30 numbers. The first 30
+    // numbers are written one by one and doubled by memcpy until the segment is full.
+    size_t filled = (len < 30) ? len : 30;
+    for(size_t i = 0 ; i < filled ; i++){
+        uint64_t x = low + i;
+        arr[i] = (x % 2 != 0 && x % 3 != 0 && x % 5 != 0);
+    }
+    while(filled < len){
+        size_t chunk = (len - filled < filled) ? len - filled : filled;
+        memcpy(arr + filled, arr, chunk);
+        filled += chunk;
+    }
+
+    // 0 and 1 are not prime, 2, 3 and 5 are
+    for(uint64_t i = low ; i <= 5 && i <= high ; i++){
+        arr[i - low] = (i == 2 || i == 3 || i == 5);
+    }
+
+    // all calculations are done with offsets relative to low, so nothing can overflow close to UINT64_MAX
+    for(size_t i = 0 ; i < count ; i++){
+        uint64_t p = primes[i];
+        uint64_t square = p * p;
+        if(square > high){
+            break;
+        }
+        if(p < 7){
+            continue;
+        }
+
+        // first multiple p * k of p that is not less than low and not less than p^2, smaller multiples are
+        // already crossed off by smaller primes
+        uint64_t offset;
+        uint64_t k;
+        if(square >= low){
+            offset = square - low;
+            k = p;
+        }else{
+            offset = (p - low % p) % p;
+            k = low / p + (offset != 0);
+        }
+
+        // primes with at least one turn of the wheel per segment take the unrolled kernel
+        if(30 * p <= len){
+            offset += wheelDistance[k % 30] * p;
+            crossWheel(arr, len, offset, p, wheelIndex[k % 30]);
+            continue;
+        }
+
+        // even multiples are already removed, so the first odd multiple is searched
+        if((k & 1) == 0){
+            offset += p;
+        }
+        for(uint64_t j = offset ; j < len ; j += 2 * p){
+            arr[j] = false;
+        }
+    }
+}
+
+// numbers per segment while the sieving primes are generated
+#define SIEVING_SEGMENT 262144
+
+// odd sieving primes up to limit (< 2^32) are written into *out, the number of primes is returned. 2 is not needed
+// because even numbers are removed while initialising a segment. The primes are stored in 32 bits, because sieving
+// primes never exceed sqrt(UINT64_MAX). SIZE_MAX is returned if memory can not be allocated.
+// Only the primes until sqrt(limit) <= 65535 come from sOE, the rest of [0, limit] is sieved segment by segment with
+// them, so a limit of 2^32 takes about 4 bytes per prime (813 MB) instead of a bool per number and 8 bytes per prime.
+size_t sievingPrimes(uint64_t limit, uint32_t** out){
+
+    *out = NULL;
+    if(limit < 3){
+        return 0;
+    }
+    if(limit > UINT32_MAX){
+        limit = UINT32_MAX;
+    }
+
+    // pi(x) < 1.25506 * x / ln x for x > 1 (Rosser and Schoenfeld 1962), below 17 every odd number is counted
+    size_t bound = (limit < 17) ? limit / 2 + 1 : (size_t)(1.25506 * limit / log((double)limit)) + 1;
+    uint64_t root = isqrt(limit);
+    uint64_t* small = (uint64_t*)malloc((root / 2 + 2) * sizeof(uint64_t));
+    uint32_t* primes = (uint32_t*)malloc(bound * sizeof(uint32_t));
+    bool* arr = (bool*)malloc(SIEVING_SEGMENT);
+    bool allocated = (small != NULL && primes != NULL && arr != NULL);
+    size_t count = (allocated && root >= 2) ? sOE(root, small) : 0;
+    if(!allocated || (root >= 2 && count == 0)){
+        free(small);
+        free(primes);
+        free(arr);
+        return SIZE_MAX;
+    }
+
+    // 2 is the first prime found by sOE, it is skipped here. The odd primes until root sieve the rest.
+    for(size_t i = 1 ; i < count ; i++){
+        primes[i - 1] = (uint32_t)small[i];
+    }
+    free(small);
+    size_t base = (count == 0) ? 0 : count - 1;
+    count = base;
+
+    for(uint64_t low = (root < 3) ? 3 : root + 1 ; low <= limit ; low += SIEVING_SEGMENT){
+        uint64_t high = (limit - low < SIEVING_SEGMENT) ? limit : low + SIEVING_SEGMENT - 1;
+        sieveSegment(low, high, arr, primes, base);
+        for(uint64_t i = 0 ; i <= high - low ; i++){
+            if(arr[i]){
+                primes[count++] = (uint32_t)(low + i);
+            }
+        }
+    }
+    free(arr);
+    *out = primes;
+    return count;
+}
+
+// sieves every number of [low, high] segment by segment and calls f for each segment in increasing order.
+// If f returns false the sieving stops. The sieving primes of the context are used if high does not exceed its
+// sieve limit, otherwise the call sieves its own sieving primes. If the context has a cache, segments are taken
+// from it, and segments that are not cached yet are sieved completely and stored.
+int sieveRange(const primegen_ctx* ctx, uint64_t low, uint64_t high, primegen_segment_fn f, void* arg){
+
+    if(low > high){
+        return PRIMEGEN_OK;
+    }
+
+    // with a cache the last segment is sieved until its end, so it can be stored as well
+    size_t segmentSize = ctx->tuning.segmentSize;
+    uint64_t top = (ctx->cache != NULL) ? (high | (segmentSize - 1)) : high;
+
+    const uint32_t* primes = ctx->sievingPrimes;
+    size_t count = ctx->sievingCount;
+    uint32_t* own = NULL;
+    if(top > ctx->tuning.sieveLimit){
+        count = sievingPrimes(isqrt(top), &own);
+        if(count == SIZE_MAX){
+            return PRIMEGEN_ENOMEM;
+        }
+        primes = own;
+    }
+
+    bool* arr = (bool*)malloc(segmentSize);
+    if(arr == NULL){
+        free(own);
+        return PRIMEGEN_ENOMEM;
+    }
+
+    uint64_t index = low / segmentSize;
+    while(true){
+        uint64_t segLow = index * segmentSize;
+        uint64_t segHigh = segLow + (segmentSize - 1);
+
+        // the first and the last segment are clipped to the range
+        primegen_segment seg;
+        seg.low = (segLow < low) ? low : segLow;
+        seg.high = (segHigh > high) ? high : segHigh;
+        seg.arr = arr;
+
+        if(ctx->cache == NULL){
+            sieveSegment(seg.low, seg.high, arr, primes, count);
+        }else{
+            const cache_entry_t* entry = lookupSegment(ctx->cache, index);
+            if(entry != NULL){
+                decodeSegment(ctx->cache, entry, seg.low, seg.high, arr);
+                releaseSegment(ctx->cache, entry);
+            }else{
+                sieveSegment(segLow, segHigh, arr, primes, count);
+                storeSegment(ctx->cache, index, arr);
+                seg.arr = arr + (seg.low - segLow);
+            }
+        }
+
+        if(!f(&seg, arg) || seg.high == high){
+            break;
+        }
+        index++;
+    }
+
+    free(arr);
+    free(own);
+    return PRIMEGEN_OK;
+}
@@ -0,0 +1,418 @@
+#define _GNU_SOURCE
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Long running query server on a UNIX domain socket. The context with its sieving primes and the table is created
+// once at startup and shared read only by all workers, so a query only pays for its own work.
+//
+// Protocol: one request per line, one response per request in the same order.
+//   is_prime <x>       ok 1 / ok 0
+//   nth_prime <n>      ok <nth prime>
+//   pi <x>             ok <number of primes <= x>
+//   next_prime <x>     ok <smallest prime > x>
+//   prev_prime <x>     ok <largest prime < x>
+//   range <a> <b>      ok <count> <primes in [a, b]...>
+//   stats              ok <cache hits> <cache misses> <cache evictions> <cached bytes>
+// Errors are answered with "error <message>".
+//
+// Every worker waits on the same epoll instance. Connections are registered with EPOLLONESHOT, so a connection is
+// served by one worker at a time: the worker reads everything the client has sent so far, answers all complete
+// lines as one batch with a single write and re-arms the connection afterwards.
+
+// widest range that is answered, larger ranges should be sieved by the library directly
+#define MAX_RANGE_WIDTH 16777216ULL
+// a connection is closed if a single line grows beyond this length
+#define MAX_LINE_LENGTH 4096
+// at most that many bytes are read for one batch, the rest is answered in the next batch
+#define MAX_BATCH_BYTES 1048576
+
+typedef struct {
+    int fd;
+    char* buf;          // bytes received but not answered yet, always a partial line
+    size_t len;
+    size_t cap;
+} connection_t;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} response_t;
+
+typedef struct {
+    const primegen_ctx* ctx;
+    int epfd;
+    int listenFd;
+} server_t;
+
+static volatile sig_atomic_t stopServer = 0;
+
+static void onSignal(int sig){
+    (void)sig;
+    stopServer = 1;
+}
+
+// appends formatted text to the response, false is returned if memory can not be allocated
+static bool appendf(response_t* out, const char* fmt, ...){
+
+    while(true){
+        va_list args;
+        va_start(args, fmt);
+        int written = vsnprintf(out->data + out->len, out->cap - out->len, fmt, args);
+        va_end(args);
+        if(written < 0){
+            return false;
+        }
+        if(out->len + (size_t)written < out->cap){
+            out->len += written;
+            return true;
+        }
+        size_t cap = (out->cap == 0) ? 4096 : out->cap * 2;
+        while(cap <= out->len + (size_t)written){
+            cap *= 2;
+        }
+        char* data = (char*)realloc(out->data, cap);
+        if(data == NULL){
+            return false;
+        }
+        out->data = data;
+        out->cap = cap;
+    }
+}
+
+// reads a decimal 64 bit number, false is returned for invalid input
+static bool parseNumber(const char* str, uint64_t* value){
+
+    if(str == NULL || *str < '0' || *str > '9'){
+        return false;
+    }
+    char* end;
+    errno = 0;
+    *value = strtoull(str, &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+typedef struct {
+    response_t primes;
+    uint64_t count;
+    bool complete;      // false if memory for the primes can not be allocated
+} range_answer_t;
+
+static bool appendSegment(const primegen_segment* seg, void* arg){
+
+    range_answer_t* range = (range_answer_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            if(!appendf(&range->primes, " %"PRIu64, seg->low + i)){
+                range->complete = false;
+                return false;
+            }
+            range->count++;
+        }
+    }
+    return true;
+}
+
+static void appendStatus(response_t* out, int status){
+
+    switch(status){
+        case PRIMEGEN_ENOMEM: appendf(out, "error memory can not be allocated\n"); break;
+        case PRIMEGEN_ERANGE: appendf(out, "error out of the 64 bit range\n"); break;
+        default: appendf(out, "error invalid argument\n"); break;
+    }
+}
+
+// answers one request line
+static void answer(const primegen_ctx* ctx, char* line, response_t* out){
+
+    char* save;
+    char* cmd = strtok_r(line, " \t\r", &save);
+    char* first = strtok_r(NULL, " \t\r", &save);
+    char* second = strtok_r(NULL, " \t\r", &save);
+    uint64_t a, b, result;
+    int status;
+
+    if(cmd == NULL){
+        appendf(out, "error empty request\n");
+        return;
+    }
+    if(strcmp(cmd, "stats") == 0){
+        primegen_cache_stats stats;
+        if(primegen_get_cache_stats(ctx, &stats) != PRIMEGEN_OK){
+            appendf(out, "error no cache\n");
+            return;
+        }
+        appendf(out, "ok %"PRIu64" %"PRIu64" %"PRIu64" %zu\n", stats.hits, stats.misses, stats.evictions, stats.bytes);
+        return;
+    }
+    if(!parseNumber(first, &a)){
+        appendf(out, "error invalid number\n");
+        return;
+    }
+
+    if(strcmp(cmd, "is_prime") == 0){
+        appendf(out, "ok %d\n", primegen_is_prime(a) ? 1 : 0);
+        return;
+    }else if(strcmp(cmd, "nth_prime") == 0){
+        status = primegen_nth_prime(ctx, a, &result);
+    }else if(strcmp(cmd, "pi") == 0){
+        status = primegen_pi(ctx, a, &result);
+    }else if(strcmp(cmd, "next_prime") == 0){
+        status = primegen_next_prime(ctx, a, &result);
+    }else if(strcmp(cmd, "prev_prime") == 0){
+        status = primegen_prev_prime(ctx, a, &result);
+    }else if(strcmp(cmd, "range") == 0){
+        if(!parseNumber(second, &b) || b < a){
+            appendf(out, "error invalid range\n");
+            return;
+        }
+        if(b - a >= MAX_RANGE_WIDTH){
+            appendf(out, "error range is wider than %llu numbers\n", MAX_RANGE_WIDTH);
+            return;
+        }
+        // the count is written in front of the primes once it is known
+        range_answer_t range = {{NULL, 0, 0}, 0, true};
+        status = primegen_range(ctx, a, b, appendSegment, &range);
+        if(status == PRIMEGEN_OK && !range.complete){
+            status = PRIMEGEN_ENOMEM;
+        }
+        if(status == PRIMEGEN_OK){
+            appendf(out, "ok %"PRIu64"%s\n", range.count, (range.primes.data == NULL) ? "" : range.primes.data);
+        }else{
+            appendStatus(out, status);
+        }
+        free(range.primes.data);
+        return;
+    }else{
+        appendf(out, "error unknown command\n");
+        return;
+    }
+
+    if(status == PRIMEGEN_OK){
+        appendf(out, "ok %"PRIu64"\n", result);
+    }else{
+        appendStatus(out, status);
+    }
+}
+
+// writes the whole buffer to the non-blocking socket
+static bool writeAll(int fd, const char* data, size_t len){
+
+    while(len > 0){
+        ssize_t written = write(fd, data, len);
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK){
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                poll(&pfd, 1, 1000);
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+static void closeConnection(connection_t* conn){
+    close(conn->fd);
+    free(conn->buf);
+    free(conn);
+}
+
+// serves one readiness event of a connection, false is returned if the connection was closed
+static bool serveConnection(const server_t* server, connection_t* conn){
+
+    // everything available is read, so all requests that arrived together are answered as one batch
+    bool closed = false;
+    while(conn->len < MAX_BATCH_BYTES){
+        if(conn->cap - conn->len < 1024){
+            size_t cap = (conn->cap == 0) ? 8192 : conn->cap * 2;
+            char* buf = (char*)realloc(conn->buf, cap);
+            if(buf == NULL){
+                closed = true;
+                break;
+            }
+            conn->buf = buf;
+            conn->cap = cap;
+        }
+        ssize_t received = read(conn->fd, conn->buf + conn->len, conn->cap - conn->len - 1);
+        if(received > 0){
+            conn->len += received;
+            continue;
+        }
+        if(received < 0 && errno == EINTR){
+            continue;
+        }
+        if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        }
+        closed = true;
+        break;
+    }
+
+    response_t out = {NULL, 0, 0};
+    size_t start = 0;
+    for(size_t i = 0 ; i < conn->len ; i++){
+        if(conn->buf[i] == '\n'){
+            conn->buf[i] = '\0';
+            answer(server->ctx, conn->buf + start, &out);
+            start = i + 1;
+        }
+    }
+    memmove(conn->buf, conn->buf + start, conn->len - start);
+    conn->len -= start;
+
+    if(out.len != 0 && !writeAll(conn->fd, out.data, out.len)){
+        closed = true;
+    }
+    free(out.data);
+
+    if(closed || conn->len > MAX_LINE_LENGTH){
+        closeConnection(conn);
+        return false;
+    }
+
+    struct epoll_event ev = {EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, {.ptr = conn}};
+    if(epoll_ctl(server->epfd, EPOLL_CTL_MOD, conn->fd, &ev) != 0){
+        closeConnection(conn);
+        return false;
+    }
+    return true;
+}
+
+static void acceptConnections(const server_t* server){
+
+    while(true){
+        int fd = accept4(server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0){
+            break;
+        }
+        connection_t* conn = (connection_t*)calloc(1, sizeof(connection_t));
+        if(conn == NULL){
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        struct epoll_event ev = {EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, {.ptr = conn}};
+        if(epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &ev) != 0){
+            closeConnection(conn);
+        }
+    }
+
+    // the listening socket is registered with EPOLLONESHOT as well
+    struct epoll_event ev = {EPOLLIN | EPOLLONESHOT, {.ptr = NULL}};
+    epoll_ctl(server->epfd, EPOLL_CTL_MOD, server->listenFd, &ev);
+}
+
+static void* serverWorker(void* arg){
+
+    const server_t* server = (const server_t*)arg;
+    while(!stopServer){
+        struct epoll_event ev;
+        int ready = epoll_wait(server->epfd, &ev, 1, 200);
+        if(ready <= 0){
+            continue;
+        }
+        // the listening socket is registered with a NULL pointer
+        if(ev.data.ptr == NULL){
+            acceptConnections(server);
+        }else{
+            serveConnection(server, (connection_t*)ev.data.ptr);
+        }
+    }
+    return NULL;
+}
+
+// runs the server until SIGINT or SIGTERM. The first tableSize primes are kept in memory for the queries, in the
+// shared memory object sharedName if it is not NULL, so several servers on one host hold the table only once.
+// A lazy table is filled chunk by chunk by the queries that need it, so the server starts without sieving.
+// Sieved segments are cached up to cacheBytes, 0 disables the cache.
+bool runServer(const char* path, size_t tableSize, int threads, const char* sharedName, size_t cacheBytes, bool lazy){
+
+    primegen_tuning tuning = {0};
+    tuning.threads = threads;
+    tuning.cacheBytes = cacheBytes;
+    primegen_ctx ctx;
+    int status = primegen_init(&ctx, &tuning);
+    if(status == PRIMEGEN_OK){
+        if(sharedName != NULL){
+            status = primegen_attach_table(&ctx, sharedName, tableSize);
+        }else{
+            status = lazy ? primegen_create_lazy_table(&ctx, tableSize) : primegen_create_table(&ctx, tableSize);
+        }
+    }
+    if(status != PRIMEGEN_OK && status != PRIMEGEN_ERANGE){
+        fprintf(stderr,(status == PRIMEGEN_ENOMEM) ? "Memory can not be allocated!\n" : "Shared table can not be used!\n");
+        primegen_destroy(&ctx);
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr,"Invalid Argument! Socket path is too long!\n");
+        primegen_destroy(&ctx);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    // a socket left behind by an earlier server is removed, other files are never touched
+    struct stat st;
+    if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode)){
+        unlink(path);
+    }
+
+    server_t server = {&ctx, -1, -1};
+    server.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server.epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {EPOLLIN | EPOLLONESHOT, {.ptr = NULL}};
+    if(server.listenFd < 0 || server.epfd < 0
+        || bind(server.listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(server.listenFd, SOMAXCONN) != 0
+        || epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.listenFd, &ev) != 0){
+        perror("Server can not be started");
+        close(server.listenFd);
+        close(server.epfd);
+        primegen_destroy(&ctx);
+        return false;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("Serving on %s with %d thread(s) and a %stable of %zu prime numbers.\n", path, threads, lazy ? "lazily filled " : "",
+        lazy ? tableSize : ctx.tableSize);
+    fflush(stdout);
+
+    // the calling thread is one of the workers
+    pthread_t tids[threads];
+    int started = 0;
+    for(int i = 1 ; i < threads ; i++){
+        if(pthread_create(&tids[started], NULL, serverWorker, &server) == 0){
+            started++;
+        }
+    }
+    serverWorker(&server);
+    for(int i = 0 ; i < started ; i++){
+        pthread_join(tids[i], NULL);
+    }
+
+    close(server.listenFd);
+    close(server.epfd);
+    unlink(path);
+    primegen_destroy(&ctx);
+    return true;
+}
@@ -0,0 +1,248 @@
+#include "config.h"
+#include <sys/wait.h>
+
+// Sharded sieving of a large range in several processes, which may run on different machines sharing a
+// filesystem. The range is split into count contiguous shards that start at segment borders. Every shard creates
+// its own context with its own sieving primes and writes its result into a shard file: the aggregates of the shard,
+// or its primes as text lines. The merge step checks that all shards of the same range are there and sums the
+// aggregates (pairs and tuplets across shard borders included) or concatenates the primes in order.
+
+// "PGSHARD1" in ASCII
+#define SHARD_MAGIC     0x3144524148534750ULL
+// layout version of the file, incremented whenever shard_header_t or primegen_aggregate changes
+#define SHARD_VERSION   1
+#define COPY_BUFFER     1048576
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t primes;            // 1 if the primes of the shard follow the header as text lines
+    uint32_t index;
+    uint32_t count;
+    uint64_t low;               // the whole range, only shards of the same range are merged
+    uint64_t high;
+    primegen_aggregate agg;     // aggregates of the shard, only the count is set if the primes follow
+} shard_header_t;
+
+typedef struct {
+    FILE* file;
+    uint64_t count;
+} shard_output_t;
+
+// first number of a shard, count returns the end of the range. Shards start at segment borders, so no segment is
+// sieved by two shards.
+static unsigned __int128 shardStart(uint64_t low, uint64_t high, int index, int count, size_t segmentSize){
+
+    unsigned __int128 end = (unsigned __int128)high + 1;
+    if(index == 0){
+        return low;
+    }
+    if(index == count){
+        return end;
+    }
+    unsigned __int128 start = low + ((unsigned __int128)high - low + 1) * index / count;
+    start = (start + segmentSize - 1) / segmentSize * segmentSize;
+    return (start > end) ? end : start;
+}
+
+static bool writeSegment(const primegen_segment* seg, void* arg){
+
+    shard_output_t* out = (shard_output_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            fprintf(out->file, "%"PRIu64"\n", seg->low + i);
+            out->count++;
+        }
+    }
+    return !ferror(out->file);
+}
+
+// sieves shard index of count shards of [low, high] and writes the shard file path
+bool runShard(uint64_t low, uint64_t high, int index, int count, const char* path, bool primes){
+
+    primegen_ctx ctx;
+    if(primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    unsigned __int128 start = shardStart(low, high, index, count, ctx.tuning.segmentSize);
+    unsigned __int128 end = shardStart(low, high, index + 1, count, ctx.tuning.segmentSize);
+
+    FILE* file = fopen(path, "wb");
+    if(file == NULL){
+        perror(path);
+        primegen_destroy(&ctx);
+        return false;
+    }
+    shard_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SHARD_MAGIC;
+    header.version = SHARD_VERSION;
+    header.primes = primes;
+    header.index = index;
+    header.count = count;
+    header.low = low;
+    header.high = high;
+
+    // the header is written again once the shard is complete, an incomplete shard keeps a header without magic
+    shard_header_t incomplete = header;
+    incomplete.magic = 0;
+    fwrite(&incomplete, sizeof(incomplete), 1, file);
+
+    // a shard can be empty if the range is narrower than one segment per shard
+    int status = PRIMEGEN_OK;
+    if(start < end && primes){
+        shard_output_t out = {file, 0};
+        status = primegen_range(&ctx, (uint64_t)start, (uint64_t)(end - 1), writeSegment, &out);
+        header.agg.count = out.count;
+    }else if(start < end){
+        status = primegen_aggregate_range(&ctx, (uint64_t)start, (uint64_t)(end - 1), NULL, &header.agg);
+    }
+    primegen_destroy(&ctx);
+
+    bool written = status == PRIMEGEN_OK && fseek(file, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, file) == 1 && !ferror(file);
+    written = (fclose(file) == 0) && written;
+    if(!written){
+        fprintf(stderr,(status == PRIMEGEN_ENOMEM) ? "Memory can not be allocated!\n" : "Shard file %s can not be written!\n",path);
+    }
+    return written;
+}
+
+// forks one worker per shard, the shard files are named <prefix>.<index> and removed after the merge
+bool forkShards(uint64_t low, uint64_t high, int count, const char* prefix, bool primes){
+
+    size_t len = strlen(prefix) + 12;
+    char** paths = (char**)calloc(count, sizeof(char*));
+    pid_t* pids = (pid_t*)calloc(count, sizeof(pid_t));
+    bool success = (paths != NULL && pids != NULL);
+    for(int i = 0 ; i < count && success ; i++){
+        paths[i] = (char*)malloc(len);
+        success = (paths[i] != NULL);
+        if(success){
+            snprintf(paths[i], len, "%s.%d", prefix, i);
+        }
+    }
+    if(!success){
+        fprintf(stderr,"Memory can not be allocated!\n");
+    }
+
+    // buffered output would be written by every child otherwise
+    fflush(stdout);
+    fflush(stderr);
+    int started = 0;
+    while(success && started < count){
+        pids[started] = fork();
+        if(pids[started] == 0){
+            _exit(runShard(low, high, started, count, paths[started], primes) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        if(pids[started] < 0){
+            perror("Shard can not be started");
+            success = false;
+            break;
+        }
+        started++;
+    }
+    for(int i = 0 ; i < started ; i++){
+        int status;
+        if(waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS){
+            success = false;
+        }
+    }
+
+    if(success){
+        success = mergeShards(paths, count);
+    }else{
+        fprintf(stderr,"At least one shard failed!\n");
+    }
+    for(int i = 0 ; i < count && paths != NULL ; i++){
+        if(paths[i] != NULL){
+            unlink(paths[i]);
+        }
+        free(paths[i]);
+    }
+    free(paths);
+    free(pids);
+    return success;
+}
+
+// copies the primes of a shard file to stdout
+static bool copyPrimes(const char* path){
+
+    FILE* file = fopen(path, "rb");
+    char* buffer = (char*)malloc(COPY_BUFFER);
+    bool copied = (file != NULL && buffer != NULL && fseek(file, sizeof(shard_header_t), SEEK_SET) == 0);
+    size_t len;
+    while(copied && (len = fread(buffer, 1, COPY_BUFFER, file)) > 0){
+        copied = (fwrite(buffer, 1, len, stdout) == len);
+    }
+    copied = copied && !ferror(file);
+    if(file != NULL){
+        fclose(file);
+    }
+    free(buffer);
+    return copied;
+}
+
+// merges the shard files of one range in the order of their index, the files can be given in any order
+bool mergeShards(char* const paths[], int count){
+
+    shard_header_t* headers = (shard_header_t*)calloc(count, sizeof(shard_header_t));
+    int* order = (int*)malloc(count * sizeof(int));
+    if(headers == NULL || order == NULL){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        free(headers);
+        free(order);
+        return false;
+    }
+    for(int i = 0 ; i < count ; i++){
+        order[i] = -1;
+    }
+
+    bool valid = true;
+    for(int i = 0 ; i < count && valid ; i++){
+        FILE* file = fopen(paths[i], "rb");
+        valid = (file != NULL && fread(&headers[i], sizeof(shard_header_t), 1, file) == 1);
+        if(file != NULL){
+            fclose(file);
+        }
+        const shard_header_t* h = &headers[i];
+        if(!valid || h->magic != SHARD_MAGIC || h->version != SHARD_VERSION){
+            fprintf(stderr,"%s is not a complete shard file!\n",paths[i]);
+            valid = false;
+        }else if(h->count != (uint32_t)count || h->index >= (uint32_t)count){
+            fprintf(stderr,"%s is shard %u of %u, but %d shard files are given!\n",paths[i],h->index,h->count,count);
+            valid = false;
+        }else if(order[h->index] != -1 || h->low != headers[0].low || h->high != headers[0].high || h->primes != headers[0].primes){
+            fprintf(stderr,"%s does not belong to the same shards as %s or is given twice!\n",paths[i],paths[0]);
+            valid = false;
+        }else{
+            order[h->index] = i;
+        }
+    }
+
+    if(valid && headers[0].primes){
+        for(int i = 0 ; i < count && valid ; i++){
+            valid = copyPrimes(paths[order[i]]);
+            if(!valid){
+                fprintf(stderr,"Shard file %s can not be read!\n",paths[order[i]]);
+            }
+        }
+        fflush(stdout);
+    }else if(valid){
+        primegen_aggregate agg;
+        memset(&agg, 0, sizeof(agg));
+        for(int i = 0 ; i < count && valid ; i++){
+            valid = (primegen_aggregate_merge(&agg, &headers[order[i]].agg) == PRIMEGEN_OK);
+        }
+        if(valid){
+            printf("\nMerged %d shards of [%"PRIu64", %"PRIu64"].\n",count,headers[0].low,headers[0].high);
+            printAggregate(&agg);
+        }else{
+            fprintf(stderr,"The shards overlap!\n");
+        }
+    }
+    free(headers);
+    free(order);
+    return valid;
+}
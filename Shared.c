@@ -0,0 +1,155 @@
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Lookup table shared between processes through a POSIX shared memory object. The first process that creates the
+// object sieves the table directly into the mapping and sets the ready flag afterwards, every other process maps
+// the object read only and waits for the flag. The pages exist only once, no matter how many processes attach.
+
+// "PRIMEGEN" in ASCII
+#define SHARED_MAGIC    0x4e4547454d495250ULL
+// layout version of the object, incremented whenever the header or the table layout changes
+#define SHARED_VERSION  1
+
+#define SHARED_FILLING  0
+#define SHARED_READY    1
+#define SHARED_FAILED   2
+
+// the header is padded to one cache line, so the table after it is aligned for the SIMD loads of prim_V8
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t state;         // SHARED_FILLING, SHARED_READY or SHARED_FAILED, written with release semantics
+    uint64_t count;         // number of primes in the table, valid once the state is SHARED_READY
+    uint64_t requested;     // number of primes the publisher was asked for
+    int64_t publisher;      // pid of the publisher, used to detect a publisher that died while filling
+    uint8_t padding[24];
+} shared_header_t;
+
+static void setTableMapping(primegen_ctx* ctx, void* mapping, size_t size){
+
+    const shared_header_t* header = (const shared_header_t*)mapping;
+    releaseTable(ctx);
+    ctx->tableMapping = mapping;
+    ctx->tableMappingSize = size;
+    ctx->table = (uint64_t*)((char*)mapping + sizeof(shared_header_t));
+    ctx->tableSize = header->count;
+}
+
+// creates the object and fills it, called by the first process only
+static int publishTable(primegen_ctx* ctx, int fd, const char* name, size_t n){
+
+    size_t size = sizeof(shared_header_t) + n * sizeof(uint64_t);
+    void* mapping = MAP_FAILED;
+    if(ftruncate(fd, size) == 0){
+        mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if(mapping == MAP_FAILED){
+        // waiting processes can only see a failure in a header, so the object is removed instead
+        shm_unlink(name);
+        return PRIMEGEN_ENOMEM;
+    }
+
+    shared_header_t* header = (shared_header_t*)mapping;
+    header->magic = SHARED_MAGIC;
+    header->version = SHARED_VERSION;
+    header->requested = n;
+    header->publisher = getpid();
+
+    // the table is sieved directly into the shared pages, there is no private copy
+    uint64_t* table = (uint64_t*)((char*)mapping + sizeof(shared_header_t));
+    size_t total = prim(n, table);
+    if(total == 0){
+        __atomic_store_n(&header->state, SHARED_FAILED, __ATOMIC_RELEASE);
+        shm_unlink(name);
+        munmap(mapping, size);
+        return PRIMEGEN_ENOMEM;
+    }
+    header->count = total;
+    __atomic_store_n(&header->state, SHARED_READY, __ATOMIC_RELEASE);
+
+    // the publisher does not write anymore either
+    mprotect(mapping, size, PROT_READ);
+    setTableMapping(ctx, mapping, size);
+    return (total < n) ? PRIMEGEN_ERANGE : PRIMEGEN_OK;
+}
+
+// maps an object created by another process and waits until its table is ready
+static int attachTable(primegen_ctx* ctx, int fd, size_t n){
+
+    const struct timespec pause = {0, 1000000};
+
+    // the publisher might not have set the size of the object yet
+    struct stat st;
+    while(true){
+        if(fstat(fd, &st) != 0){
+            return PRIMEGEN_ESHM;
+        }
+        if((size_t)st.st_size >= sizeof(shared_header_t)){
+            break;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    size_t size = st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if(mapping == MAP_FAILED){
+        return PRIMEGEN_ENOMEM;
+    }
+
+    const shared_header_t* header = (const shared_header_t*)mapping;
+    uint32_t state;
+    while((state = __atomic_load_n(&header->state, __ATOMIC_ACQUIRE)) == SHARED_FILLING){
+        // a publisher that died while filling never sets the state
+        if(header->publisher != 0 && kill((pid_t)header->publisher, 0) != 0 && errno == ESRCH){
+            break;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    if(state != SHARED_READY || header->magic != SHARED_MAGIC || header->version != SHARED_VERSION
+        || sizeof(shared_header_t) + header->count * sizeof(uint64_t) > size){
+        munmap(mapping, size);
+        return PRIMEGEN_ESHM;
+    }
+
+    setTableMapping(ctx, mapping, size);
+    return (header->count < n) ? PRIMEGEN_ERANGE : PRIMEGEN_OK;
+}
+
+int primegen_attach_table(primegen_ctx* ctx, const char* name, size_t n){
+
+    if(ctx == NULL || name == NULL || name[0] != '/' || n == 0){
+        return PRIMEGEN_EINVAL;
+    }
+
+    // O_EXCL decides which process publishes the table
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    int status;
+    if(fd >= 0){
+        status = publishTable(ctx, fd, name, n);
+    }else if(errno == EEXIST){
+        fd = shm_open(name, O_RDONLY, 0);
+        if(fd < 0){
+            return PRIMEGEN_ESHM;
+        }
+        status = attachTable(ctx, fd, n);
+    }else{
+        return PRIMEGEN_ESHM;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    return status;
+}
+
+int primegen_unlink_table(const char* name){
+
+    if(name == NULL || name[0] != '/'){
+        return PRIMEGEN_EINVAL;
+    }
+    return (shm_unlink(name) == 0) ? PRIMEGEN_OK : PRIMEGEN_ESHM;
+}
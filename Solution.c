@@ -12,7 +12,8 @@ const char* help_msg =
     "  -n<X>   Number of prime numbers to calculate. "
     "\n\n"
     "Optional arguments:\n\n"
-    "  -V<X>    The version of implementation. (Default: X = 0)\n"
+    "  -V<X>    The version of implementation. (Default: X = auto)\n"
+    "           Version auto := The fastest version for n, the thread count and the memory budget is selected\n"
     "           Version 0 := Implementation of Segmented Sieve of Eratosthenes Algorithm (Better for large inputs)\n"  
     "           Version 1 := Brute Force with trial division prime checker (Not recommented for large inputs)\n"
     "           Version 2 := Brute Force with 6k±1 Number Theorem prime checker\n"
@@ -22,6 +23,10 @@ const char* help_msg =
     "           Version 6 := Implementation of Sieve of Atkin Algorithm\n"
     "           Version 7 := Implementation via Look Up Table (SISD)\n"
     "           Version 8 := Implementation via Look Up Table (SIMD)\n\n"
+    "  -M<X>    Memory budget in bytes, the suffixes K, M and G are accepted. (Default: no budget)\n"
+    "           With -V auto the fastest version that fits into the budget is selected, otherwise the\n"
+    "           selected version is rejected if it needs more memory than the budget.\n\n"
+    "  -t<X>    Number of threads the planner may use. (Default: X = number of online processors)\n\n"
     "  -B<X>    Execution time of the implementation is measured and returned.\n"
     "           X denotes the number of times the function is repeated. (Default: X = 1)\n\n"
     "  -T<X>    Execution time of all implementations is measured and compared.\n"
@@ -32,12 +37,315 @@ const char* help_msg =
     "           X denotes the number of prime numbers to calculate.\n"
     "           This option must be used alone.\n"
     "           Usage: ./prog_name -C<X>\n\n"
+    "  -F<X>    Fast verification of all implementations except LUT algorithms, without a reference table.\n"
+    "           The results are compared with a streamed reference sieve by their count, sum and xor-hash and\n"
+    "           checked against the known values of pi(10^k). The versions are verified in parallel.\n"
+    "           X denotes the number of prime numbers to calculate.\n"
+    "           Only -t and -M can be used together with this option.\n"
+    "           Usage: ./prog_name -F<X> [-t<threads>] [-M<bytes>]\n\n"
+    "  -s<X>    The table of Version 7 and 8 and of the server is shared between processes via the POSIX shared\n"
+    "           memory object X (e.g. /primegen). The first process creates it, the others attach read only.\n"
+    "           The object stays until it is removed (rm /dev/shm/X).\n\n"
+    "  -S<X>    Runs a query server on the UNIX domain socket X until SIGINT or SIGTERM.\n"
+    "           The first n prime numbers (-n, Default: 1000000) are kept in memory, -t sets the number of workers.\n"
+    "           Requests are lines of: is_prime <x>, nth_prime <n>, pi <x>, next_prime <x>,\n"
+    "           prev_prime <x>, range <a> <b> or stats.\n"
+    "           Every request is answered with a line \"ok <result>\" or \"error <message>\".\n"
+    "           Usage: ./prog_name -S<path> [-n<X>] [-t<threads>] [-c<bytes>] [--lazy]\n\n"
+    "  -c<X>    Sieved segments of the server are cached in an LRU cache of at most X bytes, the suffixes\n"
+    "           K, M and G are accepted. \"stats\" returns the hits, misses, evictions and cached bytes. (Default: no cache)\n\n"
+    "  -A[X]    Aggregates of the first n prime numbers are calculated without writing them into prims array:\n"
+    "           count, sum, twin/cousin/sexy pairs, triplets, quadruplets and the largest gap.\n"
+    "           With X = <a>:<b> the aggregates of the prime numbers in [a, b] are calculated instead and -n is not needed.\n"
+    "           Usage: ./prog_name -n<X> -A   or   ./prog_name -A<a>:<b>\n\n"
+    "  -k<X>    The state of -A is saved into the checkpoint file X periodically and when it is complete.\n"
+    "           A later run of the same query resumes from the checkpoint with an identical result.\n\n"
+    "  -i<X>    Seconds between two checkpoints of -k. (Default: X = 60)\n\n"
+    "  --shard <i>/<k>\n"
+    "           Only shard i (0 <= i < k) of the k contiguous shards of the range of -A<a>:<b> is sieved, its\n"
+    "           aggregates are written into the shard file -o<X>. With -p its prime numbers are written instead.\n"
+    "           Usage: ./prog_name -A<a>:<b> --shard <i>/<k> -o<file> [-p]\n\n"
+    "  --fork <k>\n"
+    "           The range of -A<a>:<b> is sieved by k forked processes, one per shard, and the shard files\n"
+    "           <X>.0 ... <X>.k-1 of the prefix -o<X> (Default: X = primegen.shard) are merged afterwards.\n"
+    "           Usage: ./prog_name -A<a>:<b> --fork <k> [-o<prefix>] [-p]\n\n"
+    "  --merge  The shard files given as arguments are merged: aggregates are summed, prime numbers are\n"
+    "           printed in order. All k shards of the same range must be given.\n"
+    "           Usage: ./prog_name --merge <files...>\n\n"
+    "  -o<X>    Output file of -p (implies -p) and --decode, output file of --shard or prefix of the shard files of --fork.\n\n"
+    "  -f<X>    Output format of -p. (Default: X = array)\n"
+    "           array := [2, 3, 5, ...]\n"
+    "           text  := One prime number per line\n"
+    "           delta := Binary blocks of halved gaps as varints, about 1 byte per prime number.\n"
+    "                    Each block starts with its first prime and count, so blocks can be skipped.\n"
+    "           raw   := uint64_t in native byte order, the layout of prims array.\n"
+    "           With -o the raw and text formats are written without a copy: raw prime numbers are calculated\n"
+    "           straight into the memory mapped file, text is formatted into it segment by segment.\n"
+    "           With text or delta and without -o, only the prime numbers are written to stdout.\n"
+    "           Without -V the prime numbers are sieved and written by a pipeline of -t threads, which starts\n"
+    "           writing after the first segment instead of after all prime numbers are calculated.\n\n"
+    "  --lazy   The table of the server (-S) is not sieved at startup. It is filled in chunks of 65536 prime numbers\n"
+    "           the first time a query needs one of them, so the startup cost follows the actual use.\n"
+    "           Not usable with -s.\n\n"
+    "  --next-prime <X>\n"
+    "           The smallest prime number above X is printed, X can be any 64 bit number.\n\n"
+    "  --prev-prime <X>\n"
+    "           The largest prime number below X is printed, X can be any 64 bit number.\n\n"
+    "  --progression <a>/<m>[,<low>:<high>]\n"
+    "           The prime numbers p = a (mod m) are printed one per line, the first n of them (-n) or those in\n"
+    "           [low, high]. Only the numbers of the progression are sieved, so the work shrinks by a factor of m.\n"
+    "           Usage: ./prog_name --progression 1/65536 -n<X> [-o<file>]\n\n"
+    "  --window <low>:<high>\n"
+    "           The prime numbers in [low, high] are printed one per line, the bounds may exceed 2^64 (up to 2^128)\n"
+    "           as long as the window is narrower than 2^64. Above 2^64 the numbers that survive the sieve are\n"
+    "           confirmed by Miller-Rabin, which is deterministic until about 2^81.\n"
+    "           Usage: ./prog_name --window 18446744073709551616:18446744073709561616 [-o<file>]\n\n"
+    "  --batch-pi <X>\n"
+    "  --batch-nth <X>\n"
+    "           The file X (- for stdin) holds one number per line, pi(x) or the nth prime number of each is\n"
+    "           printed in the same order. All numbers are answered by one sweep on -t threads, so overlapping\n"
+    "           prefixes are not sieved again for every query.\n"
+    "           Usage: ./prog_name --batch-pi <file> [-t<threads>] [-o<file>]\n\n"
+    "  --decode <X>\n"
+    "           The delta file X (- for stdin) is decoded into text, one prime number per line.\n"
+    "           Usage: ./prog_name --decode <file> [-o<file>]\n\n"
     "  -p       Prints the first n prime numbers, which are written into prims array respectively.\n"
     "           (Not usable with -T and -B options)\n\n"
     "  -h       A description of all the program options and usage examples are issued.\n\n"
     "  --help   A description of all the program options and usage examples are issued.\n\n";
 
 
+// reads a number of bytes with an optional K, M or G suffix, 0 is returned for invalid input
+size_t parseBytes(const char* str){
+
+    char* end;
+    unsigned long long value = strtoull(str, &end, 10);
+    switch(*end){
+        case 'K': case 'k': value <<= 10; end++; break;
+        case 'M': case 'm': value <<= 20; end++; break;
+        case 'G': case 'g': value <<= 30; end++; break;
+        default: break;
+    }
+    if(end == str || *end != '\0'){
+        return 0;
+    }
+    return (size_t)value;
+}
+
+// printing total number of primes makes sense because there is a constant number of primes that can be represented in 64 bit unsigned.
+// If the limit is exceeded user can be aware of that.
+void printTableInfo(size_t n, size_t total){
+    printf("\nThe program was asked to create a table consisting of %zu prime numbers.\n", n);
+    printf("Total of %zu prime numbers are in the table.\n", total);
+    if (n > total) {
+        printf("Total number of primes that can be represented in uint64_t has a limit, therefore table has less elements than desired. The difference is %zu.\n\n", n - total);
+    }
+    printf("The infos printed untill here are regarding the table creation method. Copying from table to prims[] will start as soon as this message is printed.\n\n");
+}
+
+// initialises the context and creates its table of the first n primes for the LUT versions. If a shared memory
+// name is given, the table is attached from the shared memory object instead (and published there first if needed).
+bool createContextTable(primegen_ctx* ctx, size_t n, const char* sharedName, bool quiet){
+
+    if(primegen_init(ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    int status = (sharedName != NULL) ? primegen_attach_table(ctx, sharedName, n) : primegen_create_table(ctx, n);
+    if(status == PRIMEGEN_ENOMEM || status == PRIMEGEN_ESHM || status == PRIMEGEN_EINVAL){
+        if(status == PRIMEGEN_ENOMEM){
+            fprintf(stderr,"Memory can not be allocated!\n");
+        }else{
+            fprintf(stderr,"Shared table %s can not be used!\n",sharedName);
+        }
+        primegen_destroy(ctx);
+        return false;
+    }
+    if(status == PRIMEGEN_ERANGE && sharedName != NULL){
+        fprintf(stderr,"Shared table %s holds only %zu prime numbers, remove it to create a larger one!\n",sharedName,ctx->tableSize);
+        primegen_destroy(ctx);
+        return false;
+    }
+    if(!quiet){
+        printTableInfo(n, ctx->tableSize);
+    }
+    return true;
+}
+
+// releases prims array, or the view the LUT versions printed from together with the context holding its table
+static void releaseOutput(uint64_t* prims, size_t n, bool mapped, primegen_view* view, primegen_ctx* ctx){
+
+    if(view != NULL){
+        primegen_release_view(view);
+        primegen_destroy(ctx);
+    }else if(prims != NULL){
+        releasePrims(prims,n,mapped);
+    }
+}
+
+// reads a range <a>:<b> with a <= b
+bool parseRange(const char* str, uint64_t* low, uint64_t* high){
+
+    char* end;
+    *low = strtoull(str, &end, 10);
+    if(end == str || *end != ':'){
+        return false;
+    }
+    const char* second = end + 1;
+    *high = strtoull(second, &end, 10);
+    return end != second && *end == '\0' && *low <= *high;
+}
+
+// prints an unsigned 128 bit number, printf has no conversion for it
+static void printU128(unsigned __int128 x){
+
+    char digits[40];
+    int len = 0;
+    do{
+        digits[len++] = '0' + (int)(x % 10);
+        x /= 10;
+    }while(x != 0);
+    while(len > 0){
+        putchar(digits[--len]);
+    }
+}
+
+void printAggregate(const primegen_aggregate* agg){
+
+    printf("\ncount:       %"PRIu64"\n",agg->count);
+    printf("sum:         ");
+    printU128(agg->sum);
+    printf("\nchecksum:    %016"PRIx64"\n",agg->checksum);
+    printf("first:       %"PRIu64"\n",agg->first);
+    printf("last:        %"PRIu64"\n",agg->last);
+    printf("twins:       %"PRIu64"\n",agg->twins);
+    printf("cousins:     %"PRIu64"\n",agg->cousins);
+    printf("sexy:        %"PRIu64"\n",agg->sexy);
+    printf("triplets:    %"PRIu64"\n",agg->triplets);
+    printf("quadruplets: %"PRIu64"\n",agg->quadruplets);
+    printf("max gap:     %"PRIu64" after %"PRIu64"\n\n",agg->maxGap,agg->maxGapStart);
+}
+
+// calculates and prints the aggregates of [low, high], or of the first n primes if n is not 0. The state is saved
+// into the checkpoint file if it is not NULL.
+bool printAggregates(uint64_t low, uint64_t high, size_t n, const primegen_checkpoint* checkpoint){
+
+    primegen_ctx ctx;
+    primegen_aggregate agg;
+    if(primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    int status = (n != 0) ? primegen_aggregate_first(&ctx, n, checkpoint, &agg)
+                          : primegen_aggregate_range(&ctx, low, high, checkpoint, &agg);
+    primegen_destroy(&ctx);
+    if(status == PRIMEGEN_ENOMEM){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    if(status == PRIMEGEN_EIO){
+        fprintf(stderr,"Checkpoint file %s can not be used, it may belong to another query!\n",checkpoint->path);
+        return false;
+    }
+    if(status == PRIMEGEN_ERANGE){
+        fprintf(stderr,"Only %"PRIu64" prime numbers can be represented in uint64_t!\n",agg.count);
+        return false;
+    }
+
+    printAggregate(&agg);
+    return true;
+}
+
+// prints the prime next to the number str, the smallest one above it if up is set or the largest one below it
+bool printNearPrime(const char* str, bool up){
+
+    char* end;
+    uint64_t x = strtoull(str, &end, 10);
+    if(end == str || *end != '\0'){
+        fprintf(stderr,"Invalid Argument! %s is not a number!\n",str);
+        return false;
+    }
+    primegen_ctx ctx;
+    if(primegen_init(&ctx, NULL) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    uint64_t prime;
+    int status = up ? primegen_next_prime(&ctx, x, &prime) : primegen_prev_prime(&ctx, x, &prime);
+    primegen_destroy(&ctx);
+    if(status != PRIMEGEN_OK){
+        fprintf(stderr,up ? "There is no prime number above %s in uint64_t!\n" : "There is no prime number below %s!\n",str);
+        return false;
+    }
+    printf("%"PRIu64"\n",prime);
+    return true;
+}
+
+// reads an unsigned 128 bit decimal number, end is set behind it. false is returned if there is no digit or it overflows.
+static bool parseU128(const char* str, unsigned __int128* x, const char** end){
+
+    *x = 0;
+    *end = str;
+    for( ; **end >= '0' && **end <= '9' ; (*end)++){
+        unsigned __int128 digit = (unsigned __int128)(**end - '0');
+        if(*x > (~(unsigned __int128)0 - digit) / 10){
+            return false;
+        }
+        *x = *x * 10 + digit;
+    }
+    return *end != str;
+}
+
+// prints the primes of the window str = <low>:<high>, both bounds can exceed 2^64
+bool printWindow(const char* str, const char* outputPath){
+
+    unsigned __int128 low, high;
+    const char* end;
+    if(!parseU128(str, &low, &end) || *end != ':' || !parseU128(end + 1, &high, &end) || *end != '\0' || low > high){
+        fprintf(stderr,"Invalid Argument! The window must be given as <low>:<high> with low <= high < 2^128!\n");
+        return false;
+    }
+    FILE* out = (outputPath != NULL) ? fopen(outputPath,"wb") : stdout;
+    if(out == NULL){
+        perror(outputPath);
+        return false;
+    }
+    bool written = writeWindow(out, low, high);
+    return (fclose(out) == 0) && written;
+}
+
+// prints the primes of the progression str = <a>/<m>[,<low>:<high>], the first n of them if no range is given
+bool printProgression(const char* str, size_t n, const char* outputPath){
+
+    char* end;
+    uint64_t a = strtoull(str, &end, 10);
+    uint64_t m = 0;
+    if(end != str && *end == '/'){
+        const char* second = end + 1;
+        m = strtoull(second, &end, 10);
+        m = (end == second) ? 0 : m;
+    }
+    uint64_t low = 0;
+    uint64_t high = UINT64_MAX;
+    bool range = (*end == ',');
+    if(m == 0 || (*end != '\0' && !range) || (range && !parseRange(end + 1, &low, &high))){
+        fprintf(stderr,"Invalid Argument! The progression must be given as <a>/<m> or <a>/<m>,<low>:<high> with m > 0!\n");
+        return false;
+    }
+    if(!range && n == 0){
+        fprintf(stderr,"Invalid Argument! The progression needs -n<X> or a range <low>:<high>!\n");
+        return false;
+    }
+
+    FILE* out = (outputPath != NULL) ? fopen(outputPath,"wb") : stdout;
+    if(out == NULL){
+        perror(outputPath);
+        return false;
+    }
+    bool written = writeProgression(out, a, m, low, high, (range && n == 0) ? SIZE_MAX : n);
+    return (fclose(out) == 0) && written;
+}
+
 // outputs the usage and help messages 
 void print_usage(const char* prog_name){
     fprintf(stderr,usage_msg,prog_name,prog_name,prog_name,prog_name,prog_name);
@@ -51,7 +359,9 @@ void print_help(const char* prog_name){
 int main(int argc, char** argv){
 
 int opt;                        // storing the result of getopt in each iteration
-int version = 0;                // storing version
+int version = VERSION_AUTO;     // storing version, selected by the planner if not given
+int threads = sysconf(_SC_NPROCESSORS_ONLN); // storing the thread count for option -t<threads>
+size_t budget = 0;              // storing the memory budget for option -M<bytes>, 0 means no budget
 int repeat = 1;                 // storing repeat time for option -B<repeat>
 bool mandatory_given = false;   // checking if the mandatory argument is used in the command line 
 bool marker = false;            // checking if the option -B is used 
@@ -59,6 +369,25 @@ bool printPrims = false;        // checking if the option -p is used
 size_t n;                       // storing the first parameter of function prim
 size_t g;                       // storing the first parameter of function prim for the option -T (execution time tests)
 size_t g_new;                   // storing the first parameter of function prim for the option -C (correctness tests)
+size_t g_verify = 0;            // storing the first parameter of function prim for the option -F (verification), 0 if not used
+const char* socketPath = NULL;  // storing the socket path for the option -S (server), NULL if not used
+const char* sharedName = NULL;  // storing the shared memory name for the option -s (shared table), NULL if not used
+size_t cacheBytes = 0;          // storing the cache cap for the option -c<bytes>, 0 means no cache
+bool lazy = false;              // checking if the option --lazy is used
+bool aggregate = false;         // checking if the option -A is used
+const char* aggregateRange = NULL; // storing the range <a>:<b> of the option -A, NULL for the first n primes
+primegen_checkpoint checkpoint = {NULL, 0}; // storing the checkpoint file and interval for the options -k and -i
+int shardIndex = 0;             // storing i of the option --shard i/k
+int shardCount = 0;             // storing k of the option --shard i/k, 0 if not used
+int forkCount = 0;              // storing k of the option --fork k, 0 if not used
+bool merge = false;             // checking if the option --merge is used
+const char* outputPath = NULL;  // storing the output file for the option -o
+int format = OUTPUT_ARRAY;      // storing the output format for the option -f
+const char* decodePath = NULL;  // storing the delta file for the option --decode, NULL if not used
+const char* progression = NULL; // storing <a>/<m>[,<low>:<high>] of the option --progression, NULL if not used
+const char* window = NULL;      // storing <low>:<high> of the option --window, NULL if not used
+const char* batchPath = NULL;   // storing the query file of the options --batch-pi and --batch-nth, NULL if not used
+bool batchNth = false;          // checking if the queries of batchPath are nth prime queries
 double time = 0;                // storing the time for the option -B
 const char* prog_name = argv[0];// storing the program name : ./solution
 
@@ -74,12 +403,34 @@ char str[] = "--help";
     }
 
     // Reading the mandatory/optional arguments from command line
-    while((opt = getopt(argc,argv,"T:V:B::C:n:hp")) != -1){
+    // options without a short form are numbered after the characters
+    enum { OPT_SHARD = 256, OPT_FORK, OPT_MERGE, OPT_DECODE, OPT_NEXT_PRIME, OPT_PREV_PRIME, OPT_LAZY, OPT_PROGRESSION, OPT_WINDOW, OPT_BATCH_PI, OPT_BATCH_NTH };
+    const struct option longOptions[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"shard", required_argument, NULL, OPT_SHARD},
+        {"fork", required_argument, NULL, OPT_FORK},
+        {"merge", no_argument, NULL, OPT_MERGE},
+        {"decode", required_argument, NULL, OPT_DECODE},
+        {"next-prime", required_argument, NULL, OPT_NEXT_PRIME},
+        {"prev-prime", required_argument, NULL, OPT_PREV_PRIME},
+        {"lazy", no_argument, NULL, OPT_LAZY},
+        {"progression", required_argument, NULL, OPT_PROGRESSION},
+        {"window", required_argument, NULL, OPT_WINDOW},
+        {"batch-pi", required_argument, NULL, OPT_BATCH_PI},
+        {"batch-nth", required_argument, NULL, OPT_BATCH_NTH},
+        {NULL, 0, NULL, 0}
+    };
+
+    while((opt = getopt_long(argc,argv,"T:V:B::C:F:S:s:c:A::k:i:o:f:n:M:t:hp",longOptions,NULL)) != -1){
     
         switch (opt){
     
         // Decision of which version of the function is to be executed
         case 'V':
+            if(strcmp(optarg,"auto") == 0){
+                version = VERSION_AUTO;
+                break;
+            }
             version = atol(optarg);
             if(version < 0 || version > 8){
                 fprintf(stderr,"Invalid Argument! There is no such a version!\n");
@@ -99,6 +450,24 @@ char str[] = "--help";
             marker = true;
             break;
         
+        // Memory budget for the planner
+        case 'M':
+            budget = parseBytes(optarg);
+            if(budget == 0){
+                fprintf(stderr,"Invalid Argument! Memory budget must be a positive number of bytes!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        // Thread count for the planner
+        case 't':
+            threads = atol(optarg);
+            if(threads < 1){
+                fprintf(stderr,"Invalid Argument! Thread count cannot be less than 1!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
         // parameter for calculating first n prime numbers
         case 'n': 
             n = atol(optarg);
@@ -134,6 +503,125 @@ help:   case 'h':
             free(prims_test_correct);
             return EXIT_SUCCESS;
              
+        // Running streaming verification, started after all options are read so -t and -M are known
+        case 'F':
+            g_verify = atol(optarg);
+            if(g_verify == 0){
+                fprintf(stderr,"Invalid Argument! Size is 0. Nothing is verified!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        // Running the query server, started after all options are read so -n and -t are known
+        case 'S':
+            socketPath = optarg;
+            break;
+
+        // Cache cap of the server
+        case 'c':
+            cacheBytes = parseBytes(optarg);
+            if(cacheBytes == 0){
+                fprintf(stderr,"Invalid Argument! Cache size must be a positive number of bytes!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        // Aggregates instead of the prime numbers themselves
+        case 'A':
+            aggregate = true;
+            aggregateRange = optarg;
+            break;
+
+        // Checkpoint file and interval of -A
+        case 'k':
+            checkpoint.path = optarg;
+            break;
+
+        case 'i':
+            if(atol(optarg) < 1){
+                fprintf(stderr,"Invalid Argument! Checkpoint interval cannot be less than 1 second!\n");
+                return EXIT_FAILURE;
+            }
+            checkpoint.interval = atol(optarg);
+            break;
+
+        // One shard of a range, given as i/k
+        case OPT_SHARD:
+            if(sscanf(optarg,"%d/%d",&shardIndex,&shardCount) != 2 || shardCount < 1 || shardIndex < 0 || shardIndex >= shardCount){
+                fprintf(stderr,"Invalid Argument! The shard must be given as <i>/<k> with 0 <= i < k!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        // All shards of a range in forked processes
+        case OPT_FORK:
+            forkCount = atol(optarg);
+            if(forkCount < 1){
+                fprintf(stderr,"Invalid Argument! Number of processes cannot be less than 1!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case OPT_MERGE:
+            merge = true;
+            break;
+
+        case 'o':
+            outputPath = optarg;
+            break;
+
+        // Output format of -p
+        case 'f':
+            if(strcmp(optarg,"array") == 0){
+                format = OUTPUT_ARRAY;
+            }else if(strcmp(optarg,"text") == 0){
+                format = OUTPUT_TEXT;
+            }else if(strcmp(optarg,"delta") == 0){
+                format = OUTPUT_DELTA;
+            }else if(strcmp(optarg,"raw") == 0){
+                format = OUTPUT_RAW;
+            }else{
+                fprintf(stderr,"Invalid Argument! There is no such an output format!\n");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case OPT_DECODE:
+            decodePath = optarg;
+            break;
+
+        // Prime numbers next to a single number
+        case OPT_NEXT_PRIME:
+        case OPT_PREV_PRIME:
+            return printNearPrime(optarg, opt == OPT_NEXT_PRIME) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+        // Prime numbers of an arithmetic progression, printed after all options are read so -n and -o are known
+        case OPT_PROGRESSION:
+            progression = optarg;
+            break;
+
+        // Prime numbers of a window that may lie beyond 2^64, printed after all options are read so -o is known
+        case OPT_WINDOW:
+            window = optarg;
+            break;
+
+        // Batches of queries, answered after all options are read so -t and -o are known
+        case OPT_BATCH_PI:
+        case OPT_BATCH_NTH:
+            batchPath = optarg;
+            batchNth = (opt == OPT_BATCH_NTH);
+            break;
+
+        // Table of the server is filled on first access
+        case OPT_LAZY:
+            lazy = true;
+            break;
+
+        // Sharing the table between processes
+        case 's':
+            sharedName = optarg;
+            break;
+
         // get the information whether -p option is used  
         case 'p':
             printPrims = true;
@@ -146,6 +634,81 @@ help:   case 'h':
         }
     }   
     
+    if(g_verify != 0){
+        return verifyCorrectness(g_verify,threads,budget) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(socketPath != NULL){
+        if(lazy && sharedName != NULL){
+            fprintf(stderr,"Invalid Argument! A shared table can not be filled lazily!\n");
+            return EXIT_FAILURE;
+        }
+        return runServer(socketPath,mandatory_given ? n : 1000000,threads,sharedName,cacheBytes,lazy) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(batchPath != NULL){
+        FILE* in = (strcmp(batchPath,"-") == 0) ? stdin : fopen(batchPath,"r");
+        FILE* out = (outputPath != NULL) ? fopen(outputPath,"wb") : stdout;
+        if(in == NULL || out == NULL){
+            perror((in == NULL) ? batchPath : outputPath);
+            return EXIT_FAILURE;
+        }
+        bool answered = answerBatch(in,out,batchNth,threads);
+        return (fclose(out) == 0 && answered) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(window != NULL){
+        return printWindow(window,outputPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(progression != NULL){
+        return printProgression(progression,mandatory_given ? n : 0,outputPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(decodePath != NULL){
+        FILE* in = (strcmp(decodePath,"-") == 0) ? stdin : fopen(decodePath,"rb");
+        FILE* out = (outputPath != NULL) ? fopen(outputPath,"wb") : stdout;
+        if(in == NULL || out == NULL){
+            perror((in == NULL) ? decodePath : outputPath);
+            return EXIT_FAILURE;
+        }
+        bool decoded = decodeDelta(in,out);
+        return (fclose(out) == 0 && decoded) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(merge){
+        if(optind >= argc){
+            fprintf(stderr,"Invalid Argument! No shard files are given!\n");
+            return EXIT_FAILURE;
+        }
+        return mergeShards(&argv[optind],argc - optind) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(aggregateRange != NULL){
+        uint64_t low;
+        uint64_t high;
+        if(!parseRange(aggregateRange,&low,&high)){
+            fprintf(stderr,"Invalid Argument! The range must be given as <a>:<b> with a <= b!\n");
+            return EXIT_FAILURE;
+        }
+        if(shardCount != 0){
+            if(outputPath == NULL){
+                fprintf(stderr,"Invalid Argument! --shard needs a shard file -o<file>!\n");
+                return EXIT_FAILURE;
+            }
+            return runShard(low,high,shardIndex,shardCount,outputPath,printPrims) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if(forkCount != 0){
+            return forkShards(low,high,forkCount,(outputPath != NULL) ? outputPath : "primegen.shard",printPrims) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        return printAggregates(low,high,0,(checkpoint.path != NULL) ? &checkpoint : NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(shardCount != 0 || forkCount != 0){
+        fprintf(stderr,"Invalid Argument! Shards need a range -A<a>:<b>!\n");
+        return EXIT_FAILURE;
+    }
+
     // checking the mandatory argument
     if(!mandatory_given){
         fprintf(stderr,"\n-n is a mandatory argument!\n");
@@ -158,12 +721,71 @@ help:   case 'h':
         return EXIT_FAILURE;
     }
 
-    uint64_t* prims = (uint64_t*)malloc(n * sizeof(uint64_t));
-    if(prims == NULL){
-        fprintf(stderr,"Invalid Argument! Memory can not be allocated!\n");
+    if(aggregate){
+        return printAggregates(0,0,n,(checkpoint.path != NULL) ? &checkpoint : NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // an output file implies -p
+    printPrims = printPrims || outputPath != NULL;
+
+    // with text or delta on stdout the prime numbers are the only output
+    bool quiet = printPrims && format != OUTPUT_ARRAY && outputPath == NULL;
+
+    // text files are formatted by the range sieve directly, the versions are not used
+    if(outputPath != NULL && format == OUTPUT_TEXT && !marker){
+        return mapText(outputPath,n) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // without a selected version the prime numbers are sieved and written in a pipeline, so no prims array is
+    // needed and the output starts after the first segment. Raw output files are mapped instead.
+    if(printPrims && !marker && version == VERSION_AUTO && !(outputPath != NULL && format == OUTPUT_RAW)){
+        FILE* out = (outputPath != NULL) ? fopen(outputPath,"wb") : stdout;
+        if(out == NULL){
+            perror(outputPath);
+            return EXIT_FAILURE;
+        }
+        bool array = (format == OUTPUT_ARRAY);
+        if(array){
+            fprintf(out,(out == stdout) ? "\nFirst %zu prime numbers:\n[" : "[",n);
+        }
+        bool written = pipePrimes(n,out,format,(threads > 1) ? threads - 1 : 1);
+        if(array){
+            fprintf(out,(out == stdout) ? "]\n\n" : "]");
+        }
+        return (fclose(out) == 0 && written) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Selecting the version by the planner or checking the selected one against the memory budget
+    if(version == VERSION_AUTO){
+        version = planVersion(n,threads,budget);
+        if(version == VERSION_AUTO){
+            fprintf(stderr,"Invalid Argument! First %zu prime numbers do not fit into the memory budget of %zu bytes!\n",n,budget);
+            return EXIT_FAILURE;
+        }
+        if((marker || printPrims) && !quiet){
+            printf("\nVersion %d is selected for the first %zu prime numbers.\n",version,n);
+        }
+    }else if(budget != 0 && planMemory(version,n) > budget){
+        fprintf(stderr,"Invalid Argument! Version %d needs about %zu bytes, which exceeds the memory budget of %zu bytes!\n",version,planMemory(version,n),budget);
         return EXIT_FAILURE;
     }
+
+    // raw files are mapped and the version writes into the file instead of a heap buffer
+    bool mapped = (outputPath != NULL && format == OUTPUT_RAW && !marker);
+    // the LUT versions print straight from a view of their table, so prims array is not needed at all
+    bool viewed = (version >= 7 && printPrims && !marker && !mapped);
+    uint64_t* prims = NULL;
+    if(!viewed){
+        prims = mapped ? mapPrims(outputPath,n) : (uint64_t*)allocateLarge(n * sizeof(uint64_t),false,threads);
+        if(prims == NULL){
+            fprintf(stderr,mapped ? "Output file can not be mapped!\n" : "Invalid Argument! Memory can not be allocated!\n");
+            return EXIT_FAILURE;
+        }
+    }
     size_t result;
+    primegen_ctx ctx;           // context holding the table of the LUT versions, destroyed after printing if viewed
+    primegen_view view = {NULL, 0, NULL};
+    const uint64_t* output = prims; // prime numbers that are printed
     
     // Decision which version will be executed 
     switch(version){
@@ -225,29 +847,45 @@ help:   case 'h':
             break;
 
         case 7:
-            if(printPrims){
+            if(printPrims && !quiet){
                 printf("\nTable is being created...\n");
             }
-            table = createTable(n);
+            if(!createContextTable(&ctx,n,sharedName,quiet)){
+                releasePrims(prims,n,mapped);
+                return EXIT_FAILURE;
+            }
             if(marker){
-                time += get_time_prim(prim_V7,n,prims,repeat);
+                time += get_time_table(prim_V7,ctx.table,(ctx.tableSize < n) ? ctx.tableSize : n,prims,repeat);
+            }else if(viewed){
+                result = (primegen_view_table(&ctx,(ctx.tableSize < n) ? ctx.tableSize : n,&view) == PRIMEGEN_OK) ? view.count : 0;
+                output = view.primes;
             }else{
-                result = prim_V7(n,prims);
+                result = prim_V7(ctx.table,(ctx.tableSize < n) ? ctx.tableSize : n,prims);
+            }
+            if(!viewed){
+                primegen_destroy(&ctx);
             }
-            free(table);
             break;
 
         case 8:
-            if(printPrims){
+            if(printPrims && !quiet){
                 printf("\nTable is being created...\n");
             }
-            table = createTable(n);
+            if(!createContextTable(&ctx,n,sharedName,quiet)){
+                releasePrims(prims,n,mapped);
+                return EXIT_FAILURE;
+            }
             if(marker){
-                time += get_time_prim(prim_V8,n,prims,repeat);
+                time += get_time_table(prim_V8,ctx.table,(ctx.tableSize < n) ? ctx.tableSize : n,prims,repeat);
+            }else if(viewed){
+                result = (primegen_view_table(&ctx,(ctx.tableSize < n) ? ctx.tableSize : n,&view) == PRIMEGEN_OK) ? view.count : 0;
+                output = view.primes;
             }else{
-                result = prim_V8(n,prims);
+                result = prim_V8(ctx.table,(ctx.tableSize < n) ? ctx.tableSize : n,prims);
+            }
+            if(!viewed){
+                primegen_destroy(&ctx);
             }
-            free(table);
             break;
 
         default: 
@@ -260,23 +898,45 @@ help:   case 'h':
         printf("First %zu prime numbers are calculated in %.7f seconds in total.\n",n,time);
         printf("First %zu prime numbers are calculated in %.7f seconds in average.\n\n",n,time/repeat);
     }
+    // Versions return 0 if their memory can not be allocated
+    else if(result == 0){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        releaseOutput(prims,n,mapped,viewed ? &view : NULL,&ctx);
+        return EXIT_FAILURE;
+    }
     //Printing results 
     else{
+        if(mapped){
+            // the file is cut to the prime numbers that were calculated
+            releasePrims(prims,n,mapped);
+            if(truncate(outputPath,(off_t)((result < n) ? result : n) * sizeof(uint64_t)) != 0){
+                perror(outputPath);
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
         if(result != 0 && printPrims){
-            printf("\nFirst %zu prime numbers:\n",n);                
-            printf("[");           
-            for(size_t i = 0 ; i < result ; i++){
-                if(i == n - 1){
-                    printf("%"PRIu64"",prims[i]);
-                    break;
-                }
-                printf("%"PRIu64", ",prims[i]);
+            FILE* out = (outputPath != NULL) ? fopen(outputPath,"wb") : stdout;
+            if(out == NULL){
+                perror(outputPath);
+                releaseOutput(prims,n,mapped,viewed ? &view : NULL,&ctx);
+                return EXIT_FAILURE;
+            }
+            if(format == OUTPUT_ARRAY && out == stdout){
+                printf("\nFirst %zu prime numbers:\n",n);
+            }
+            bool written = writePrimes(out,output,(result < n) ? result : n,format);
+            if(format == OUTPUT_ARRAY && out == stdout){
+                printf("\n\n");
+            }
+            if(fclose(out) != 0 || !written){
+                fprintf(stderr,"Prime numbers can not be written!\n");
+                releaseOutput(prims,n,mapped,viewed ? &view : NULL,&ctx);
+                return EXIT_FAILURE;
             }
-            printf("]");
-            printf("\n\n");
         }
     }
 
-    free(prims);
+    releaseOutput(prims,n,mapped,viewed ? &view : NULL,&ctx);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -44,19 +44,25 @@ void compareTime(size_t n, uint64_t prims[n]){
     sleep(2);
 
     printf("\nLook Up Table is being created for Version 6 and 7...\n\n");
-    table = createTable((size_t)n);
+    size_t total;
+    uint64_t* table = createTable((size_t)n, &total);
+    if(table == NULL){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return;
+    }
+    printTableInfo(n, total);
     sleep(2);
 
-    time += get_time_prim(prim_V7,n,prims,3);
+    time += get_time_table(prim_V7,table,n,prims,3);
     printf("-> Version 7 calculates first %zu prime numbers in %f seconds.\n",n,(time/3));
 
     time = 0;
     sleep(2);
 
-    time += get_time_prim(prim_V8,n,prims,3);
+    time += get_time_table(prim_V8,table,n,prims,3);
     printf("-> Version 8 calculates first %zu prime numbers in %f seconds.\n\n",n,(time/3));
    
-    free(table);
+    freeLarge(table);
 
 }
 
@@ -64,7 +70,13 @@ void compareTime(size_t n, uint64_t prims[n]){
 // LUT algorithms are not included in this test, because the comparing element is the LUT itself.
 void compareCorrectness(size_t n, uint64_t prims[n]){
 
-    table = createTable(n);
+    size_t total;
+    uint64_t* table = createTable(n, &total);
+    if(table == NULL){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return;
+    }
+    printTableInfo(n, total);
     printf("\nRunning correctness tests...\n\n");
     sleep(2);
 
@@ -206,4 +218,220 @@ void compareCorrectness(size_t n, uint64_t prims[n]){
         printf("-> Version 6 successfully calculated the first %zu prime numbers!\n\n",result);
     }
 
-}
\ No newline at end of file
+    freeLarge(table);
+}
+
+// Streaming verification: instead of creating a reference table of n elements, the primes of every version are
+// reduced to order independent checksums (count, sum, xor-hash) that are compared with the checksums of a streamed
+// reference sieve. Every stream is additionally checked against the known values of pi(10^k). Besides the prims[]
+// arrays of the versions themselves only O(segment) memory is used. The versions are verified in parallel.
+
+// pi(10^k) for k = 1, ..., 19
+static const uint64_t piCheckpoints[][2] = {
+    {10ULL,                   4ULL},
+    {100ULL,                  25ULL},
+    {1000ULL,                 168ULL},
+    {10000ULL,                1229ULL},
+    {100000ULL,               9592ULL},
+    {1000000ULL,              78498ULL},
+    {10000000ULL,             664579ULL},
+    {100000000ULL,            5761455ULL},
+    {1000000000ULL,           50847534ULL},
+    {10000000000ULL,          455052511ULL},
+    {100000000000ULL,         4118054813ULL},
+    {1000000000000ULL,        37607912018ULL},
+    {10000000000000ULL,       346065536839ULL},
+    {100000000000000ULL,      3204941750802ULL},
+    {1000000000000000ULL,     29844570422669ULL},
+    {10000000000000000ULL,    279238341033925ULL},
+    {100000000000000000ULL,   2623557157654233ULL},
+    {1000000000000000000ULL,  24739954287740860ULL},
+    {10000000000000000000ULL, 234057667276344607ULL},
+};
+
+typedef struct {
+    size_t count;           // number of primes seen
+    size_t limit;           // the stream stops after limit primes
+    unsigned __int128 sum;  // sum of all primes, 128 bit can not overflow
+    uint64_t hash;          // xor of all mixed primes, independent of the order
+    uint64_t last;          // last prime seen
+    bool ordered;           // primes came in strictly increasing order
+    bool checkpoints;       // all pi(10^k) that were passed matched
+    size_t next;            // index of the next checkpoint to pass
+} checksum_t;
+
+typedef struct {
+    int version;            // -1 := streamed reference sieve
+    bool allocated;         // false if memory could not be allocated
+    checksum_t sum;
+} verify_job_t;
+
+typedef struct {
+    const primegen_ctx* ctx;
+    size_t n;
+    verify_job_t* jobs;
+    size_t count;
+    size_t next;            // index of the next job, taken by an atomic increment
+} verify_pool_t;
+
+// versions that are verified, LUT versions are not included because their table is created by Version 0
+static size_t (*const verifiedVersions[])(size_t, uint64_t*) = {
+    prim, prim_V1, prim_V2, prim_V3, prim_V4, prim_V5, prim_V6
+};
+
+static void checksumAdd(checksum_t* c, uint64_t p){
+
+    // every checkpoint below p is passed now, so the number of primes seen so far must be pi(10^k)
+    size_t checkpoints = sizeof(piCheckpoints) / sizeof(piCheckpoints[0]);
+    while(c->next < checkpoints && p > piCheckpoints[c->next][0]){
+        if(c->count != piCheckpoints[c->next][1]){
+            c->checkpoints = false;
+        }
+        c->next++;
+    }
+
+    if(c->count != 0 && p <= c->last){
+        c->ordered = false;
+    }
+    c->count++;
+    c->sum += p;
+    c->hash ^= mixPrime(p);
+    c->last = p;
+}
+
+static bool checksumSegment(const primegen_segment* seg, void* arg){
+
+    checksum_t* c = (checksum_t*)arg;
+    for(uint64_t i = 0 ; i <= seg->high - seg->low ; i++){
+        if(seg->arr[i]){
+            checksumAdd(c, seg->low + i);
+            if(c->count == c->limit){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void runVerifyJob(const primegen_ctx* ctx, size_t n, verify_job_t* job){
+
+    memset(&job->sum, 0, sizeof(checksum_t));
+    job->sum.limit = n;
+    job->sum.ordered = true;
+    job->sum.checkpoints = true;
+
+    if(job->version < 0){
+        job->allocated = (sieveRange(ctx, 0, approximate(n), checksumSegment, &job->sum) == PRIMEGEN_OK);
+        return;
+    }
+
+    uint64_t* prims = (uint64_t*)malloc(n * sizeof(uint64_t));
+    if(prims == NULL){
+        job->allocated = false;
+        return;
+    }
+    size_t result = verifiedVersions[job->version](n, prims);
+    job->allocated = (result != 0);
+    for(size_t i = 0 ; i < result ; i++){
+        checksumAdd(&job->sum, prims[i]);
+    }
+    free(prims);
+}
+
+static void* verifyWorker(void* arg){
+
+    verify_pool_t* pool = (verify_pool_t*)arg;
+    size_t i;
+    while((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count){
+        runVerifyJob(pool->ctx, pool->n, &pool->jobs[i]);
+    }
+    return NULL;
+}
+
+// verifies all versions except the LUT versions for the first n primes with the given number of threads.
+// If a memory budget is given (0 := no budget), fewer versions run at the same time.
+bool verifyCorrectness(size_t n, int threads, size_t budget){
+
+    size_t versions = sizeof(verifiedVersions) / sizeof(verifiedVersions[0]);
+    verify_job_t jobs[versions + 1];
+    jobs[0].version = -1;
+    for(size_t i = 0 ; i < versions ; i++){
+        jobs[i + 1].version = (int)i;
+    }
+    primegen_tuning tuning = {0};
+    tuning.threads = threads;
+    tuning.memoryBudget = budget;
+    primegen_ctx ctx;
+    if(primegen_init(&ctx, &tuning) != PRIMEGEN_OK){
+        fprintf(stderr,"Memory can not be allocated!\n");
+        return false;
+    }
+    verify_pool_t pool = {&ctx, n, jobs, versions + 1, 0};
+
+    // every running version holds its own prims[], so the budget limits how many versions can run at once
+    size_t workers = (threads < 1) ? 1 : (size_t)threads;
+    if(budget != 0){
+        size_t largest = 0;
+        for(size_t i = 0 ; i < versions ; i++){
+            size_t memory = planMemory((int)i, n);
+            largest = (memory > largest) ? memory : largest;
+        }
+        size_t fit = budget / largest;
+        workers = (fit < workers) ? fit : workers;
+        workers = (workers < 1) ? 1 : workers;
+    }
+    workers = (workers > versions + 1) ? versions + 1 : workers;
+
+    printf("\nRunning streaming verification with %zu thread(s)...\n\n", workers);
+
+    // the calling thread works as well
+    pthread_t tids[workers];
+    size_t started = 0;
+    for(size_t i = 1 ; i < workers ; i++){
+        if(pthread_create(&tids[started], NULL, verifyWorker, &pool) == 0){
+            started++;
+        }
+    }
+    verifyWorker(&pool);
+    for(size_t i = 0 ; i < started ; i++){
+        pthread_join(tids[i], NULL);
+    }
+    primegen_destroy(&ctx);
+
+    const checksum_t* ref = &jobs[0].sum;
+    if(!jobs[0].allocated){
+        fprintf(stderr,"-> Reference sieve failed, memory can not be allocated!\n\n");
+        return false;
+    }
+    if(!ref->ordered || !ref->checkpoints){
+        fprintf(stderr,"-> Reference sieve does not match the known values of pi(10^k)!\n\n");
+        return false;
+    }
+    printf("-> Reference: %zu prime numbers, the largest one is %"PRIu64", hash %016"PRIx64".\n",ref->count,ref->last,ref->hash);
+
+    bool all = true;
+    for(size_t i = 1 ; i <= versions ; i++){
+        const checksum_t* c = &jobs[i].sum;
+        const char* reason = NULL;
+        if(!jobs[i].allocated){
+            reason = "memory can not be allocated";
+        }else if(c->count != ref->count){
+            reason = "number of primes differs";
+        }else if(!c->ordered){
+            reason = "primes are not in increasing order";
+        }else if(!c->checkpoints){
+            reason = "pi(10^k) does not match";
+        }else if(c->sum != ref->sum || c->hash != ref->hash){
+            reason = "checksums differ";
+        }
+
+        if(reason != NULL){
+            fprintf(stderr,"-> Version %d failed while calculating the first %zu prime numbers (%s)!\n",jobs[i].version,n,reason);
+            all = false;
+        }else{
+            printf("-> Version %d successfully calculated the first %zu prime numbers!\n",jobs[i].version,n);
+        }
+    }
+    printf("\n");
+    return all;
+}
@@ -0,0 +1,199 @@
+#include "config.h"
+
+// Window sieve beyond 2^64. Sieving primes until the square root of 2^80 would be 2^40 numbers large, so windows
+// above 2^64 are sieved with the sieving primes of the context only (odd primes until sqrt(tuning.sieveLimit)) and
+// the survivors are confirmed by Miller-Rabin in 128 bit Montgomery arithmetic. The first 13 primes as bases are
+// deterministic for n < 3.3 * 10^24 (about 2^81.4), above that the test is a strong probable prime test.
+// The part of a window below 2^64 is sieved by sieveRange() as before.
+
+// the window offsets are kept in 64 bits, a segment more is needed for the last one
+#define MAX_WINDOW_WIDTH    (UINT64_MAX - (1ULL << 32))
+
+typedef unsigned __int128 uint128_t;
+
+static const uint64_t wideBases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41};
+
+// Montgomery arithmetic modulo an odd n with R = 2^128, as montgomery_t of Prim.c one size larger
+typedef struct {
+    uint128_t n;
+    uint128_t inverse;  // n^-1 mod 2^128
+    uint128_t one;      // R mod n
+    uint128_t d;        // n - 1 = d * 2^e with d odd
+    int e;
+} montgomery128_t;
+
+// high half of the 256 bit product a * b, the low half is returned in low
+static inline uint128_t multiplyHigh(uint128_t a, uint128_t b, uint128_t* low){
+
+    uint128_t a0 = (uint64_t)a, a1 = a >> 64;
+    uint128_t b0 = (uint64_t)b, b1 = b >> 64;
+    uint128_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    uint128_t mid = (p00 >> 64) + (uint64_t)p01 + (uint64_t)p10;
+    *low = (mid << 64) | (uint64_t)p00;
+    return p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+}
+
+static void montgomery128Init(montgomery128_t* m, uint128_t n){
+
+    m->n = n;
+    // n is its own inverse modulo 8, 6 Newton steps give 192 correct bits
+    m->inverse = n;
+    for(int i = 0 ; i < 6 ; i++){
+        m->inverse *= 2 - n * m->inverse;
+    }
+    m->one = (0 - n) % n;
+    m->d = n - 1;
+    m->e = 0;
+    while((m->d & 1) == 0){
+        m->d >>= 1;
+        m->e++;
+    }
+}
+
+// a * b / R mod n for a, b < n, the low halves of a * b and q * n cancel
+static inline uint128_t montgomery128Mul(uint128_t a, uint128_t b, const montgomery128_t* m){
+
+    uint128_t low;
+    uint128_t high = multiplyHigh(a, b, &low);
+    uint128_t q = low * m->inverse;
+    uint128_t h = multiplyHigh(q, m->n, &low);
+    return (high >= h) ? high - h : high - h + m->n;
+}
+
+// x + y mod n for x, y < n, the sum may not fit into 128 bits
+static inline uint128_t addMod(uint128_t x, uint128_t y, uint128_t n){
+    uint128_t sum = x + y;
+    return (sum < x || sum >= n) ? sum - n : sum;
+}
+
+// one strong probable prime test of the odd n of m to the small base a
+static bool strongProbablePrime128(const montgomery128_t* m, uint64_t a){
+
+    // a * R mod n is added up from R mod n bit by bit, a is small
+    uint128_t base = 0;
+    for(int bit = 63 - __builtin_clzll(a) ; bit >= 0 ; bit--){
+        base = addMod(base, base, m->n);
+        if((a >> bit) & 1){
+            base = addMod(base, m->one, m->n);
+        }
+    }
+    uint128_t minusOne = m->n - m->one;
+    uint128_t x = m->one;
+    for(uint128_t k = m->d ; k != 0 ; k >>= 1){
+        if(k & 1){
+            x = montgomery128Mul(x, base, m);
+        }
+        base = montgomery128Mul(base, base, m);
+    }
+    if(x == m->one || x == minusOne){
+        return true;
+    }
+    for(int e = m->e ; --e > 0 ; ){
+        x = montgomery128Mul(x, x, m);
+        if(x == minusOne){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Miller-Rabin for an odd n above 2^64
+static bool checkPrimeWide(uint128_t n){
+
+    montgomery128_t m;
+    montgomery128Init(&m, n);
+    for(size_t i = 0 ; i < sizeof(wideBases) / sizeof(wideBases[0]) ; i++){
+        if(!strongProbablePrime128(&m, wideBases[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    primegen_segment128_fn f;
+    void* arg;
+    bool stopped;
+} narrow_window_t;
+
+// hands a segment of sieveRange() on as a 128 bit segment
+static bool narrowSegment(const primegen_segment* seg, void* arg){
+
+    narrow_window_t* window = (narrow_window_t*)arg;
+    primegen_segment128 wide = {seg->low, seg->high, seg->arr};
+    window->stopped = !window->f(&wide, window->arg);
+    return !window->stopped;
+}
+
+int primegen_range128(const primegen_ctx* ctx, uint128_t low, uint128_t high, primegen_segment128_fn f, void* arg){
+
+    if(ctx == NULL || f == NULL){
+        return PRIMEGEN_EINVAL;
+    }
+    if(low > high){
+        return PRIMEGEN_OK;
+    }
+    if(high - low > MAX_WINDOW_WIDTH){
+        return PRIMEGEN_ERANGE;
+    }
+
+    // the 64 bit part keeps the range sieve with its sieving primes and cache
+    if(low <= UINT64_MAX){
+        narrow_window_t window = {f, arg, false};
+        int status = sieveRange(ctx, (uint64_t)low, (high > UINT64_MAX) ? UINT64_MAX : (uint64_t)high, narrowSegment, &window);
+        if(status != PRIMEGEN_OK || window.stopped || high <= UINT64_MAX){
+            return status;
+        }
+        low = (uint128_t)UINT64_MAX + 1;
+    }
+
+    // offset of the next multiple of every sieving prime from low, the primes are far below the window
+    const uint32_t* primes = ctx->sievingPrimes;
+    size_t count = ctx->sievingCount;
+    size_t segmentSize = ctx->tuning.segmentSize;
+    uint64_t last = (uint64_t)(high - low);
+    bool* arr = (bool*)malloc(segmentSize);
+    uint64_t* next = (uint64_t*)malloc((count + 1) * sizeof(uint64_t));
+    if(arr == NULL || next == NULL){
+        free(arr);
+        free(next);
+        return PRIMEGEN_ENOMEM;
+    }
+    for(size_t k = 0 ; k < count ; k++){
+        next[k] = (primes[k] - (uint64_t)(low % primes[k])) % primes[k];
+    }
+
+    for(uint64_t start = 0 ; ; start += segmentSize){
+        size_t len = (last - start < segmentSize) ? (size_t)(last - start) + 1 : segmentSize;
+        uint128_t segLow = low + start;
+        memset(arr, true, len);
+        for(size_t i = (size_t)(segLow & 1) ; i < len ; i += 2){
+            arr[i] = false;
+        }
+        for(size_t k = 0 ; k < count ; k++){
+            if(next[k] - start >= len){
+                continue;
+            }
+            size_t i = next[k] - start;
+            for( ; i < len ; i += primes[k]){
+                arr[i] = false;
+            }
+            next[k] = start + i;
+        }
+        // the survivors have no factor below the sieving limit, Miller-Rabin decides about the rest
+        for(size_t i = 0 ; i < len ; i++){
+            if(arr[i] && !checkPrimeWide(segLow + i)){
+                arr[i] = false;
+            }
+        }
+
+        primegen_segment128 seg = {segLow, segLow + (len - 1), arr};
+        if(!f(&seg, arg) || last - start < segmentSize){
+            break;
+        }
+    }
+
+    free(arr);
+    free(next);
+    return PRIMEGEN_OK;
+}
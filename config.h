@@ -14,19 +14,23 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <inttypes.h>
-
-// LOOK UP TABLE
-static uint64_t *table;
+#include <pthread.h>
+#include <getopt.h>
+#include "primegen.h"
 
 // HELPER FUNCTIONS
 uint64_t approximate(size_t n);  
-uint64_t* createTable(size_t n);
+uint64_t* createTable(size_t n, size_t* total);
 size_t sOE(size_t n, uint64_t prims[]);
 
 // CHECKING WHETHER A NUMBER IS PRIME OR NOT
 bool checkPrime(uint64_t n);
 bool checkPrime_V2(uint64_t n);
-bool checkPrime_V3(uint64_t n, uint64_t a);
+bool checkPrime_V4(uint64_t n);
+uint64_t nearPrime(uint64_t x, bool up);
+
+// largest prime that can be represented in 64 bits
+#define LARGEST_PRIME 18446744073709551557ULL
 
 // PRIME FUNCTIONS THAT CALCULATE FIRST N PRIMES AND WRITES INTO PRIMS ARRAY
 size_t prim(size_t n, uint64_t prims[]);
@@ -35,17 +39,88 @@ size_t prim_V2(size_t n, uint64_t prims[]);
 size_t prim_V3(size_t n, uint64_t prims[]);
 size_t prim_V4(size_t n, uint64_t prims[]);
 size_t prim_V5(size_t n, uint64_t prims[]);
+size_t sieveParallel(size_t n, uint64_t prims[], int threads, bool simd);
 size_t prim_V6(size_t n, uint64_t prims[]);
-size_t prim_V7(size_t n, uint64_t prims[]);
-size_t prim_V8(size_t n, uint64_t prims[]);
 
+// LUT VERSIONS COPY FROM A TABLE CREATED BY createTable()
+size_t prim_V7(const uint64_t table[], size_t n, uint64_t prims[]);
+size_t prim_V8(const uint64_t table[], size_t n, uint64_t prims[]);
+
+
+bool SieveOfAtkin(size_t z, uint64_t prims[],uint64_t limit);
+
+// LARGE BUFFERS BACKED BY HUGE PAGES AND PREFAULTED, RELEASED BY freeLarge()
+void* allocateLarge(size_t size, bool zeroed, int threads);
+void freeLarge(void* ptr);
+
+// SEGMENTED SIEVE OVER AN ARBITRARY RANGE, ONE SEGMENT IS HANDED TO THE CALLBACK AT A TIME
+#define DEFAULT_SEGMENT_SIZE 524288
+#define DEFAULT_SIEVE_LIMIT  1099511627776ULL
+
+uint64_t isqrt(uint64_t n);
+size_t sievingPrimes(uint64_t limit, uint32_t** out);
+void sieveSegment(uint64_t low, uint64_t high, bool* arr, const uint32_t* primes, size_t count);
+int sieveRange(const primegen_ctx* ctx, uint64_t low, uint64_t high, primegen_segment_fn f, void* arg);
+void releaseTable(primegen_ctx* ctx);
+size_t readyTable(const primegen_ctx* ctx, const uint64_t** table);
 
-void SieveOfAtkin(size_t z, uint64_t prims[],uint64_t limit);
+// LOOKUP TABLE THAT IS FILLED CHUNK BY CHUNK ON FIRST ACCESS
+primegen_lazy_table* createLazyTable(size_t n);
+void retainLazyTable(primegen_lazy_table* lazy);
+void releaseLazyTable(primegen_lazy_table* lazy);
+size_t lazyReady(const primegen_lazy_table* lazy, const uint64_t** primes);
+int fillLazyTable(const primegen_ctx* ctx, primegen_lazy_table* lazy, size_t count, const uint64_t** primes);
+int fillLazyTableTo(const primegen_ctx* ctx, primegen_lazy_table* lazy, uint64_t x, const uint64_t** primes);
+
+// AGGREGATES
+uint64_t mixPrime(uint64_t p);
+
+// SEGMENT CACHE
+typedef struct cache_entry cache_entry_t;
+primegen_cache* createCache(size_t capacity, size_t segmentSize);
+void destroyCache(primegen_cache* cache);
+const cache_entry_t* lookupSegment(primegen_cache* cache, uint64_t index);
+void releaseSegment(primegen_cache* cache, const cache_entry_t* entry);
+void storeSegment(primegen_cache* cache, uint64_t index, const bool* arr);
+void decodeSegment(const primegen_cache* cache, const cache_entry_t* entry, uint64_t low, uint64_t high, bool* arr);
+
+// PLANNER THAT SELECTS THE FASTEST VERSION FOR N, THE THREAD COUNT AND A MEMORY BUDGET
+#define VERSION_AUTO -1
+size_t planMemory(int version, size_t n);
+int planVersion(size_t n, int threads, size_t budget);
 
 // BENCHMARK & TEST FUNCTIONS
 void compareTime(size_t n, uint64_t prims[]);
 void compareCorrectness(size_t n, uint64_t prims[]);
+bool verifyCorrectness(size_t n, int threads, size_t budget);
 double get_time_prim(size_t (*f) (size_t,uint64_t*),size_t size, uint64_t* prims,int repeat);
+double get_time_table(size_t (*f) (const uint64_t*,size_t,uint64_t*),const uint64_t* table,size_t size, uint64_t* prims,int repeat);
+void printTableInfo(size_t n, size_t total);
+void printAggregate(const primegen_aggregate* agg);
+
+// OUTPUT OF THE PRIME NUMBERS
+#define OUTPUT_ARRAY    0   // [2, 3, 5], the default of -p
+#define OUTPUT_TEXT     1   // one prime per line
+#define OUTPUT_DELTA    2   // delta format of libprimegen
+#define OUTPUT_RAW      3   // uint64_t in native byte order, the layout of prims[]
+int formatNumber(char* buf, uint64_t x);
+bool writePrimes(FILE* out, const uint64_t prims[], size_t count, int format);
+bool pipePrimes(size_t n, FILE* out, int format, int threads);
+uint64_t* mapPrims(const char* path, size_t n);
+void releasePrims(uint64_t* prims, size_t n, bool mapped);
+bool mapText(const char* path, size_t n);
+bool decodeDelta(FILE* in, FILE* out);
+bool writeProgression(FILE* out, uint64_t a, uint64_t m, uint64_t low, uint64_t high, size_t n);
+bool writeWindow(FILE* out, unsigned __int128 low, unsigned __int128 high);
+bool answerBatch(FILE* in, FILE* out, bool nth, int threads);
+
+// SHARDED SIEVING IN SEVERAL PROCESSES
+bool runShard(uint64_t low, uint64_t high, int index, int count, const char* path, bool primes);
+bool forkShards(uint64_t low, uint64_t high, int count, const char* prefix, bool primes);
+bool mergeShards(char* const paths[], int count);
+
+// QUERY SERVER ON A UNIX DOMAIN SOCKET
+bool runServer(const char* path, size_t tableSize, int threads, const char* sharedName, size_t cacheBytes, bool lazy);
 
 
 
@@ -0,0 +1,258 @@
+#ifndef PRIMEGEN_H
+#define PRIMEGEN_H
+
+// Public interface of libprimegen. All state lives in an explicit context, the library has no global variables
+// apart from constant tables that are built once on first use, never prints and never exits. A context is filled
+// by primegen_init() and primegen_create_table() and is read only afterwards, so any number of threads can share
+// one context without locking. A lazily filled table synchronizes its own filling, so it can be shared right away.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ERROR CODES, every function returning int returns one of these
+#define PRIMEGEN_OK       0
+#define PRIMEGEN_ENOMEM  -1     // memory can not be allocated
+#define PRIMEGEN_EINVAL  -2     // invalid argument
+#define PRIMEGEN_ERANGE  -3     // the request exceeds the table or the 64 bit limit
+#define PRIMEGEN_ESHM    -4     // the shared memory object can not be created or used
+#define PRIMEGEN_EIO     -5     // the checkpoint file can not be read or written, or belongs to another query
+
+// LRU CACHE OF SIEVED SEGMENTS, shared by all threads using the context
+typedef struct primegen_cache primegen_cache;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t bytes;           // memory used by the cached segments
+} primegen_cache_stats;
+
+// LOOKUP TABLE THAT IS FILLED CHUNK BY CHUNK ON FIRST ACCESS
+typedef struct primegen_lazy_table primegen_lazy_table;
+
+// READ ONLY VIEW OF THE FIRST count PRIMES OF THE TABLE, no prime is copied
+typedef struct {
+    const uint64_t* primes;
+    size_t count;
+    primegen_lazy_table* lazy;  // reference held on a lazy table, NULL for the other tables
+} primegen_view;
+
+// TUNING, 0 selects the default of a field
+typedef struct {
+    uint64_t sieveLimit;    // ranges until sieveLimit use the sieving primes of the context (Default: 2^40)
+    size_t segmentSize;     // numbers per segment of the range sieve, a power of 2 (Default: 2^19)
+    int threads;            // threads the planner may use (Default: number of online processors)
+    size_t memoryBudget;    // memory budget in bytes for the planner (Default: no budget)
+    size_t cacheBytes;      // memory cap of the segment cache, 0 disables the cache (Default: 0)
+} primegen_tuning;
+
+// CONTEXT
+typedef struct {
+    primegen_tuning tuning;
+    uint64_t* table;            // first tableSize primes, NULL if no table was created
+    size_t tableSize;
+    void* tableMapping;         // shared memory mapping holding the table, NULL if the table is private
+    size_t tableMappingSize;
+    uint32_t* sievingPrimes;    // odd primes until sqrt(tuning.sieveLimit)
+    size_t sievingCount;
+    primegen_cache* cache;      // NULL if tuning.cacheBytes is 0
+    primegen_lazy_table* lazy;  // NULL unless primegen_create_lazy_table() was called, replaces table
+} primegen_ctx;
+
+// ONE SIEVED SEGMENT OF A RANGE
+typedef struct {
+    uint64_t low;       // first number of the segment
+    uint64_t high;      // last number of the segment, included
+    const bool* arr;    // arr[i] == true <=> low + i is prime
+} primegen_segment;
+
+// called for every segment of a range in increasing order, returning false stops the sieving
+typedef bool (*primegen_segment_fn)(const primegen_segment* seg, void* arg);
+
+// ONE SIEVED SEGMENT OF A WINDOW THAT MAY REACH BEYOND 2^64
+typedef struct {
+    unsigned __int128 low;
+    unsigned __int128 high;     // included
+    const bool* arr;            // arr[i] == true <=> low + i is prime
+} primegen_segment128;
+
+typedef bool (*primegen_segment128_fn)(const primegen_segment128* seg, void* arg);
+
+// ONE SIEVED SEGMENT OF AN ARITHMETIC PROGRESSION, it holds only the numbers of the progression
+typedef struct {
+    uint64_t first;     // first number of the segment
+    uint64_t step;      // difference of consecutive numbers, the modulus of the progression
+    size_t count;       // numbers in the segment
+    const bool* arr;    // arr[i] == true <=> first + i * step is prime
+} primegen_progression_segment;
+
+// called for every segment of a progression in increasing order, returning false stops the sieving
+typedef bool (*primegen_progression_fn)(const primegen_progression_segment* seg, void* arg);
+
+// ITERATOR OVER ALL PRIMES FROM A START VALUE ON, sieves one segment at a time
+typedef struct {
+    const primegen_ctx* ctx;
+    uint64_t next;          // first number that is not sieved yet
+    bool end;               // all numbers until UINT64_MAX are sieved
+    uint64_t* primes;       // primes of the current segment
+    size_t count;
+    size_t pos;
+} primegen_iterator;
+
+// UNIFORM RANDOM PRIMES OF A RANGE, the same seed and range give the same primes
+typedef struct {
+    uint64_t low;
+    uint64_t high;          // included
+    uint64_t seed;
+    uint64_t counter;       // random numbers used so far
+    uint64_t first;         // first odd number of the range
+    uint64_t candidates;    // odd numbers of the range, and 2 if it lies in the range
+    bool two;
+} primegen_sampler;
+
+// AGGREGATES OVER THE PRIMES OF A RANGE, pairs and tuplets are counted if all of their primes lie in the range
+typedef struct {
+    uint64_t count;
+    unsigned __int128 sum;
+    uint64_t checksum;      // xor of the mixed primes, compares the primes of two runs
+    uint64_t first;         // smallest prime, 0 if count is 0
+    uint64_t last;          // largest prime
+    uint64_t twins;         // pairs (p, p + 2)
+    uint64_t cousins;       // pairs (p, p + 4)
+    uint64_t sexy;          // pairs (p, p + 6)
+    uint64_t triplets;      // (p, p + 2, p + 6) and (p, p + 4, p + 6)
+    uint64_t quadruplets;   // (p, p + 2, p + 6, p + 8)
+    uint64_t maxGap;        // largest gap between consecutive primes, 0 if count < 2
+    uint64_t maxGapStart;   // prime in front of the largest gap, the first one if several are equally large
+    uint64_t head[4];       // smallest primes in increasing order, 0 if there are less
+    uint64_t tail[4];       // largest primes in decreasing order, 0 if there are less
+} primegen_aggregate;
+
+// CHECKPOINTS OF A LONG RUNNING AGGREGATION
+typedef struct {
+    const char* path;       // checkpoint file, a checkpoint of the same query in it is resumed
+    unsigned interval;      // seconds between two checkpoints (Default: 60)
+} primegen_checkpoint;
+
+// tuning can be NULL for the defaults
+int primegen_init(primegen_ctx* ctx, const primegen_tuning* tuning);
+void primegen_destroy(primegen_ctx* ctx);
+
+// creates the lookup table of the first n primes, must be called before the context is shared between threads
+int primegen_create_table(primegen_ctx* ctx, size_t n);
+
+// reserves a table of the first n primes without sieving any of them. The primes are sieved in chunks the first
+// time primegen_first(), primegen_nth_prime() or primegen_pi() needs them. primegen_next_prime() and
+// primegen_prev_prime() use the part that is filled so far, their window sieve is cheaper than filling chunks.
+// Filling is synchronized by the table itself, reads of filled chunks take no locks.
+int primegen_create_lazy_table(primegen_ctx* ctx, size_t n);
+
+// attaches the table of the first n primes that is published in the POSIX shared memory object name (e.g.
+// "/primegen"). The first process creates the object and sieves the table into it, all other processes wait until
+// it is ready and map it read only. PRIMEGEN_ERANGE is returned if the attached table has less than n primes.
+int primegen_attach_table(primegen_ctx* ctx, const char* name, size_t n);
+
+// removes the shared memory object, processes that are attached keep their mapping
+int primegen_unlink_table(const char* name);
+
+// view of the first n primes of the table, instead of copying them with primegen_first(). A view of a lazy table
+// fills it until n and holds a reference, so it stays valid until primegen_release_view() even if the table is
+// replaced or the context destroyed. A view of the other tables is valid as long as the table itself.
+// PRIMEGEN_ERANGE if the table has less than n primes.
+int primegen_view_table(const primegen_ctx* ctx, size_t n, primegen_view* view);
+void primegen_release_view(primegen_view* view);
+
+// first n primes are written into prims[], the number of primes written is returned (0 on failure). The table
+// is used if it is large enough, otherwise the fastest version is selected by the planner. Copies of many primes
+// use non-temporal stores, primegen_view_table() avoids the copy altogether.
+size_t primegen_first(const primegen_ctx* ctx, size_t n, uint64_t prims[]);
+
+// calls f for every sieved segment of [low, high]
+int primegen_range(const primegen_ctx* ctx, uint64_t low, uint64_t high, primegen_segment_fn f, void* arg);
+
+// calls f for every sieved segment of the window [low, high], which is narrower than 2^64 but may lie anywhere below
+// 2^128. The part below 2^64 is sieved as by primegen_range(). Above 2^64 the window is sieved by the sieving primes
+// of the context and the survivors are confirmed by Miller-Rabin, which is deterministic until about 2^81.
+// PRIMEGEN_ERANGE if the window is too wide.
+int primegen_range128(const primegen_ctx* ctx, unsigned __int128 low, unsigned __int128 high, primegen_segment128_fn f,
+    void* arg);
+
+// calls f for every sieved segment of the primes p == a (mod m) in [low, high]. Only the numbers of the progression
+// are sieved, every sieving prime crosses off every p-th of them, so the work shrinks by about a factor of m.
+int primegen_progression(const primegen_ctx* ctx, uint64_t a, uint64_t m, uint64_t low, uint64_t high,
+    primegen_progression_fn f, void* arg);
+
+// number of primes in [low, high] is written into count
+int primegen_count(const primegen_ctx* ctx, uint64_t low, uint64_t high, uint64_t* count);
+
+// aggregates of the primes in [low, high] or of the first n primes, computed per segment without writing them out.
+// If checkpoint is not NULL the state is written into its file periodically and once more when the query is
+// complete, and a run that finds a checkpoint of the same query continues from it with an identical result.
+int primegen_aggregate_range(const primegen_ctx* ctx, uint64_t low, uint64_t high, const primegen_checkpoint* checkpoint,
+    primegen_aggregate* agg);
+int primegen_aggregate_first(const primegen_ctx* ctx, uint64_t n, const primegen_checkpoint* checkpoint,
+    primegen_aggregate* agg);
+
+// merges the aggregates of the range that follows into agg, as if both ranges were aggregated at once. Pairs and
+// tuplets across the border are found through head and tail. PRIMEGEN_EINVAL if next does not follow agg.
+int primegen_aggregate_merge(primegen_aggregate* agg, const primegen_aggregate* next);
+
+// the iterator returns the primes >= start in increasing order, PRIMEGEN_ERANGE after the largest 64 bit prime
+int primegen_iterator_init(primegen_iterator* it, const primegen_ctx* ctx, uint64_t start);
+int primegen_iterator_next(primegen_iterator* it, uint64_t* prime);
+void primegen_iterator_destroy(primegen_iterator* it);
+
+// DELTA FORMAT, ascending primes as halved gaps in varints, framed in blocks with an absolute base and count.
+// A stream starts with PRIMEGEN_DELTA_MAGIC followed by the blocks.
+#define PRIMEGEN_DELTA_MAGIC    "PGDELTA1"
+#define PRIMEGEN_DELTA_HEADER   16      // bytes of a block header: base (u64), count (u32), payload bytes (u32)
+#define PRIMEGEN_DELTA_BLOCK    65536   // primes per block written by the command line program
+
+// most bytes a block of count primes can take
+size_t primegen_delta_bound(size_t count);
+
+// encodes 1 <= count <= UINT32_MAX ascending primes as one block into out, the size of the block is returned
+size_t primegen_delta_encode(const uint64_t primes[], size_t count, uint8_t* out);
+
+// reads the header of the block at in, size bytes are available. bytes is the size of the whole block, so the next
+// block can be reached without decoding this one.
+int primegen_delta_peek(const uint8_t* in, size_t size, uint64_t* base, size_t* count, size_t* bytes);
+
+// decodes the block at in into primes (at most max), the size of the block is returned or 0 if it is corrupt
+size_t primegen_delta_decode(const uint8_t* in, size_t size, uint64_t primes[], size_t max, size_t* count);
+
+// hit, miss and eviction counters of the segment cache, PRIMEGEN_EINVAL if the context has no cache
+int primegen_get_cache_stats(const primegen_ctx* ctx, primegen_cache_stats* stats);
+
+// QUERIES, answered from the table of the context where possible
+bool primegen_is_prime(uint64_t n);
+
+// number of primes <= x
+int primegen_pi(const primegen_ctx* ctx, uint64_t x, uint64_t* count);
+
+// nth prime, n starts at 1
+int primegen_nth_prime(const primegen_ctx* ctx, uint64_t n, uint64_t* prime);
+
+// answers count queries at once, counts[i] = pi(x[i]) and primes[i] = the n[i]th prime. The queries are sorted and
+// answered by one segmented sweep after the table until the largest of them, the segments are sieved by
+// tuning.threads threads and a prefix sum over their counts gives the answers.
+int primegen_pi_batch(const primegen_ctx* ctx, const uint64_t x[], size_t count, uint64_t counts[]);
+int primegen_nth_prime_batch(const primegen_ctx* ctx, const uint64_t n[], size_t count, uint64_t primes[]);
+
+// samplers draw primes of [low, high] uniformly at random: every prime of the range is equally likely and the draws
+// are independent. Candidates are drawn in batches and rejected unless prime, a window with many candidates is
+// sieved once, sparse candidates are tested by Miller-Rabin. primegen_sample() writes the next count samples into
+// primes[], a sampler continues where it stopped, so split calls give the same primes as one call.
+// primegen_sampler_init() returns PRIMEGEN_ERANGE if the range holds no prime.
+int primegen_sampler_init(primegen_sampler* sampler, uint64_t low, uint64_t high, uint64_t seed);
+int primegen_sample(const primegen_ctx* ctx, primegen_sampler* sampler, size_t count, uint64_t primes[]);
+
+// smallest prime > x, PRIMEGEN_ERANGE if there is no such prime below 2^64. A small window after x is sieved, no
+// table is needed and the answer takes a few microseconds.
+int primegen_next_prime(const primegen_ctx* ctx, uint64_t x, uint64_t* prime);
+
+// largest prime < x, PRIMEGEN_ERANGE if x <= 2
+int primegen_prev_prime(const primegen_ctx* ctx, uint64_t x, uint64_t* prime);
+
+#endif